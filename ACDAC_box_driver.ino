@@ -14,16 +14,40 @@
         - DAT on digital pin 5
 ******************************************************************************/
 
+// Parameter list capacity of Vrekrer_scpi_parser.h. Must be defined before
+// any header pulls it in. Only its SCPI_P list is used: lines are assembled
+// in line_queue.h and commands are looked up in scpi_commands.h.
+#define SCPI_ARRAY_SYZE 10  // CHANnel:ALL:STATe takes 9 parameters
+
+// Library headers first, so the poison below only covers this sketch
+#include <AD9106.h>
+#include <Adafruit_LiquidCrystal.h>
+#include <EEPROM.h>
+#include <SPI.h>
+#include <Vrekrer_scpi_parser.h>
+#include <Wire.h>
+
+// Nothing here allocates: a fragmented heap on 2 KB of SRAM ends up in the
+// stack. Using any of these fails the build. See ram_guard.h.
+#pragma GCC poison String malloc calloc realloc strdup new
+
 #include "lcd_view.h"
 #include "model.h"
 
-#include <Vrekrer_scpi_parser.h>
 #include "command_handlers.h"
+#include "command_stats.h"
 #include "global_error.h"
+#include "line_queue.h"
+#include "ram_guard.h"
+#include "scheduler.h"
+#include "scpi_commands.h"
+#include "sram_upload.h"
 #include "view_state.h"
 
 ViewState viewState;
-SCPI_Parser parser;
+LineQueue line_queue;
+ScpiDispatcher scpi(scpi_keywords, KW_END - 1, scpi_commands, scpi_slots,
+                    SCPI_HASH_MUL);
 
 const int AD9106_CS = 10;
 const int LCD_DAT = 5;
@@ -34,54 +58,115 @@ Model model(AD9106_CS);
 LCDView view(LCD_DAT, LCD_CLK, LCD_LAT, &viewState);
 
 GlobalError system_error(&GlobalErrorHandler);
+BinaryProtocol binary(&handleBinaryFrame);
+SerialLink serialLink;
+SramUpload upload(&handleUploadChunk, &handleUploadDone);
+Sequencer sequencer(&model);
+Trigger trigger(&model, &sequencer);
+RamGuard ram_guard;
+Scheduler scheduler;
+uint8_t task_link;  // reverts an unconfirmed baud rate
+
+#if CMD_STATS
+// One byte per command and named section, see command_stats.h
+const uint8_t STAT_SECTIONS = SCPI_COMMANDS + STAT_NAMED;
+uint8_t stat_slot_of[STAT_SECTIONS];
+CommandStats cmd_stats(stat_slot_of, STAT_SECTIONS);
+uint8_t stat_dispatch;  // line parse, lookup and handler
+uint8_t stat_view;      // view.update()
+#endif
+
+// The globals above against RAM_STATIC_BUDGET (ram_guard.h), so a new table
+// cannot silently push the stack into them. The host stand-ins are larger
+// than the real objects, so only AVR builds check.
+#ifdef __AVR__
+#if CMD_STATS
+const int STATS_RAM = sizeof(stat_slot_of) + sizeof(cmd_stats) + 2;
+#else
+const int STATS_RAM = 0;
+#endif
+static_assert(sizeof(viewState) + sizeof(line_queue) + sizeof(scpi) +
+                      sizeof(model) + sizeof(view) + sizeof(system_error) +
+                      sizeof(binary) + sizeof(serialLink) + sizeof(upload) +
+                      sizeof(sequencer) + sizeof(trigger) +
+                      sizeof(ram_guard) + sizeof(scheduler) +
+                      sizeof(task_link) + STATS_RAM <=
+                  RAM_STATIC_BUDGET,
+              "Globals leave too little RAM for the stack, shrink a table");
+#endif
 
 void setup() {
-  registerCommands();
-  Serial.begin(9600);
+#if CMD_STATS
+  stat_dispatch = cmd_stats.add(F("dispatch"));
+  stat_view = cmd_stats.add(F("view.update"));
+  scpi.addStats(SCPI_COMMANDS, &printCommandName);
+#endif
+  serialLink.begin();
   while (!Serial) {
     ;
   }
   model.begin();
+  trigger.begin();
+  line_queue.begin();
   view.begin();
   viewState.reset();
+
+  // Input first, so a command waits at most one pass. Budgets in us.
+  scheduler.every(F("input"), &inputTask, 0, 0, 2000);
+  scheduler.every(F("sequencer"), &sequencerTask, 0, 1, 200);
+  scheduler.every(F("display"), &displayTask, 0, 2, 500);
+  scheduler.every(F("housekeeping"), &housekeepingTask, 10, 3, 200);
+  task_link = scheduler.oneShot(F("link"), &linkTask, 3, 100);
 }
 
-void loop() {
-  parser.ProcessInput(Serial, "\n");
+void loop() { scheduler.run(); }
+
+/*********************************************************/
+// Scheduled tasks
+/*********************************************************/
+
+// Runs one queued command, the binary protocol or an SRAM upload
+void inputTask() {
+  if (binary.active) {
+    binary.process(Serial);
+    return;
+  }
+  if (upload.active) {
+    upload.process(Serial);
+    return;
+  }
+  line_queue.poll(Serial);
+  char* message = line_queue.front();
+  if (message != NULL) {
+    uint8_t length = strlen(message);
+    STAT_TIME(stat_dispatch, scpi.execute(message, Serial));
+    line_queue.pop(length);
+  }
+}
+
+void sequencerTask() { sequencer.poll(); }
+
+// Redraws the frame if the state changed, then sends part of it to the LCD
+void displayTask() {
   if (viewState.update) {
-    view.update();
+    STAT_TIME(stat_view, view.update());
   }
+  view.flush();
+}
+
+void housekeepingTask() {
+  system_error.poll();
+  ram_guard.check();
 }
 
-// Register SCPI commands to functions
-void registerCommands() {
-  // Root Commands
-  parser.RegisterCommand(F("*IDN?"), &handleIdentify);
-  parser.RegisterCommand(F("*RST"), &handleReset);
-  parser.RegisterCommand(F("FREQ"), &handleSetFreq);
-  parser.RegisterCommand(F("FREQ?"), &handleGetFreq);
-
-  // System Commands
-  parser.SetCommandTreeBase(F("SYS"));
-  parser.SetErrorHandler(&SCPIErrorHandler);
-  parser.RegisterCommand(F(":ERRor?"), &GetLastEror);
-  parser.RegisterCommand(F("REGister?"), &handleGetReg);
-  parser.RegisterCommand(F("REGister"), &handleSetReg);
-  parser.RegisterCommand(F(":DISPlay:MODE"), &changeMode);
-
-  // Pattern Commands
-  parser.SetCommandTreeBase(F("PATtern"));
-  parser.RegisterCommand(F(":STOP"), &handleStop);
-  parser.RegisterCommand(F(":START"), &handleStart);
-  parser.RegisterCommand(F(":UPDate"), &handleUpdate);
-
-  // Channel Commands
-  parser.SetCommandTreeBase(F("CHANnel#"));
-  parser.RegisterCommand(F(":VOLTage"), &handleSetVoltage);
-  parser.RegisterCommand(F(":VOLTage?"), &handleGetVoltage);
-  parser.RegisterCommand(F(":PHASe"), &handleSetPhase);
-  parser.RegisterCommand(F(":PHase?"), &handleGetPhase);
+// Armed by SYS:COMM:BAUD
+void linkTask() { serialLink.poll(); }
+
+#if CMD_STATS
+void printCommandName(uint8_t index, Stream& interface) {
+  scpi.printHeader(index, interface);
 }
+#endif
 
 // Global Error handler function
 void GlobalErrorHandler() {
@@ -0,0 +1,184 @@
+/******************************************************************************
+    @file:  binary_protocol.h
+
+    @brief: Fixed-size binary command frames, an alternative to SCPI text
+******************************************************************************/
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include "Arduino.h"
+#include "global_error.h"
+
+extern GlobalError system_error;
+
+/*
+ * Request:  SYNC(0xA5) | opcode | channel | value (int32 LE) | CRC-8
+ * Reply:    SYNC(0x5A) | opcode | status  | value (int32 LE) | CRC-8
+ *
+ * Values are fixed point in thousandths: uV, millidegrees or mHz. The CRC is
+ * CRC-8/SMBUS (poly 0x07, init 0) over every byte between SYNC and CRC.
+ * Every request gets one reply. On failure status is 1 and value holds the
+ * error code.
+ */
+const uint8_t BIN_SYNC = 0xa5;
+const uint8_t BIN_REPLY_SYNC = 0x5a;
+const uint8_t BIN_FRAME_SIZE = 8;
+const int32_t BIN_SCALE = 1000;
+const unsigned long BIN_FRAME_TIMEOUT = 50;  // ms between bytes of a frame
+
+enum BinaryOpcode : uint8_t {
+  BIN_NOP = 0x00,
+  BIN_SET_VOLT = 0x01,
+  BIN_SET_PHASE = 0x02,
+  BIN_SET_FREQ = 0x03,
+  BIN_UPDATE = 0x04,
+  BIN_START = 0x05,
+  BIN_STOP = 0x06,
+  BIN_GET_VOLT = 0x11,
+  BIN_GET_PHASE = 0x12,
+  BIN_GET_FREQ = 0x13,
+  BIN_GET_ERROR = 0x14,
+  BIN_EXIT = 0x7f  // return to SCPI
+};
+
+struct BinaryFrame {
+  uint8_t opcode;
+  uint8_t channel;  // status in replies
+  int32_t value;
+};
+
+/**
+ * @brief CRC-8/SMBUS of a byte string
+ */
+uint8_t crc8(const uint8_t* data, uint8_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+class BinaryProtocol {
+ public:
+  bool active;
+
+  /**
+   * @brief Constructor for the BinaryProtocol class
+   *
+   * @param func Called with each valid request; fills in the reply
+   */
+  BinaryProtocol(void (*func)(const BinaryFrame&, BinaryFrame&)) {
+    dispatch = func;
+    active = false;
+    length = 0;
+  }
+
+  /**
+   * @brief Switches the interface to binary frames
+   */
+  void begin() {
+    active = true;
+    length = 0;
+  }
+
+  /**
+   * @brief Switches the interface back to SCPI
+   */
+  void end() { active = false; }
+
+  /**
+   * @brief Consumes available bytes, dispatching each complete frame
+   *
+   * Bytes before a SYNC are skipped and a frame left incomplete for
+   * BIN_FRAME_TIMEOUT is dropped. A frame failing its CRC is often a lost
+   * byte that pulled in the next frame's SYNC, so parsing restarts at the
+   * next SYNC inside it, see resync().
+   */
+  void process(Stream& interface) {
+    while (active && interface.available()) {
+      uint8_t b = interface.read();
+      unsigned long now = millis();
+      if (length > 0 && now - last_byte > BIN_FRAME_TIMEOUT)
+        length = 0;
+      last_byte = now;
+
+      if (length == 0 && b != BIN_SYNC)
+        continue;
+      buffer[length++] = b;
+      if (length == BIN_FRAME_SIZE) {
+        length = 0;
+        if (!handleFrame(interface))
+          resync();
+      }
+    }
+  }
+
+  /**
+   * @brief Sends a reply frame
+   */
+  void send(Stream& interface, const BinaryFrame& frame) {
+    uint8_t out[BIN_FRAME_SIZE];
+    out[0] = BIN_REPLY_SYNC;
+    out[1] = frame.opcode;
+    out[2] = frame.channel;
+    for (uint8_t i = 0; i < 4; i++)
+      out[3 + i] = (uint32_t)frame.value >> (8 * i);
+    out[7] = crc8(out + 1, BIN_FRAME_SIZE - 2);
+    interface.write(out, BIN_FRAME_SIZE);
+  }
+
+ private:
+  void (*dispatch)(const BinaryFrame&, BinaryFrame&);
+  uint8_t buffer[BIN_FRAME_SIZE];
+  uint8_t length;
+  unsigned long last_byte = 0;
+
+  /**
+   * @brief Replies to the frame in the buffer
+   *
+   * @return false if its CRC did not match
+   */
+  bool handleFrame(Stream& interface) {
+    BinaryFrame request;
+    BinaryFrame reply;
+    request.opcode = buffer[1];
+    request.channel = buffer[2];
+    request.value = 0;
+    for (uint8_t i = 0; i < 4; i++)
+      request.value |= (uint32_t)buffer[3 + i] << (8 * i);
+
+    reply.opcode = request.opcode;
+    reply.channel = 0;
+    reply.value = 0;
+    bool valid = crc8(buffer + 1, BIN_FRAME_SIZE - 2) == buffer[7];
+    if (!valid) {
+      system_error.set_error(GenericError::BadFrame);
+      reply.channel = 1;
+      reply.value = system_error.get_error(true);
+    } else {
+      dispatch(request, reply);
+    }
+    send(interface, reply);
+    return valid;
+  }
+
+  /**
+   * @brief Keeps the bytes of a bad frame from its next SYNC on, as the
+   * start of the following frame. Dropping all of them would leave the
+   * stream misaligned until an idle gap of BIN_FRAME_TIMEOUT.
+   */
+  void resync() {
+    for (uint8_t i = 1; i < BIN_FRAME_SIZE; i++) {
+      if (buffer[i] == BIN_SYNC) {
+        length = BIN_FRAME_SIZE - i;
+        memmove(buffer, buffer + i, length);
+        return;
+      }
+    }
+  }
+};
+
+#endif
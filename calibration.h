@@ -0,0 +1,291 @@
+/******************************************************************************
+    @file:  calibration.h
+
+    @brief: Fixed-point evaluation of the amplitude and phase calibration
+******************************************************************************/
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "config.h"
+
+/*
+ * The fit in config.h gives the DGAIN word for a voltage V (mV) at frequency
+ * f (Hz) as
+ *
+ *   word = (100 V - 10 c4) / (c0 f 10^(5-e0) + ... + c3 f^4 10^(5-e3) + c5)
+ *
+ * The frequency is normalised to x = f / 2^17 (always < 1 for f <= 100 kHz)
+ * and every coefficient is pre-scaled at compile time so the polynomial runs
+ * as a Horner chain of integer multiply/shifts with no pow() calls.
+ *
+ *   c0..c3, c5 -> Q28 (|K| < 8)
+ *   10 * c4    -> Q12, same scale as 100 V
+ *   x          -> Q24
+ */
+const uint8_t CAL_COEFF_SHIFT = 28;
+const uint8_t CAL_FREQ_SHIFT = 24;
+const uint8_t CAL_NUM_SHIFT = 12;
+const uint8_t CAL_FREQ_NORM = 17;  // x = f / 2^CAL_FREQ_NORM
+
+constexpr double cal_pow10(int e) {
+  return (e == 0) ? 1.0 : (e > 0) ? 10.0 * cal_pow10(e - 1)
+                                  : cal_pow10(e + 1) / 10.0;
+}
+
+constexpr double cal_pow2(int e) {
+  return (e == 0) ? 1.0 : 2.0 * cal_pow2(e - 1);
+}
+
+constexpr int32_t cal_round(double val) {
+  return (int32_t)((val >= 0) ? val + 0.5 : val - 0.5);
+}
+
+template <class Card>
+constexpr bool cal_has_channel(int chan) {
+  return Card::channels & (1 << (chan - 1));
+}
+
+/**
+ * @brief Pre-scale coefficient `index` of a channel of a card
+ *
+ * @param chan Channel number (1-4)
+ * @param index index into the 18 element table (range * 6 + term)
+ */
+template <class Card>
+constexpr int32_t cal_fixed(int chan, int index) {
+  return !cal_has_channel<Card>(chan) ? 0
+         : (index % 6 < 4)
+             ? cal_round(Card::amp_coeffs[chan - 1][index] *
+                         cal_pow10(5 - Card::exps[index % 6]) *
+                         cal_pow2(CAL_FREQ_NORM * (index % 6 + 1) +
+                                  CAL_COEFF_SHIFT))
+         : (index % 6 == 4)
+             ? cal_round(10.0 * Card::amp_coeffs[chan - 1][index] *
+                         cal_pow2(CAL_NUM_SHIFT))
+             : cal_round(Card::amp_coeffs[chan - 1][index] *
+                         cal_pow2(CAL_COEFF_SHIFT));
+}
+
+/**
+ * @brief Lower limit of a voltage range as a cal_numerator() value
+ *
+ * Keeps the integer division of the thresholds done by the float fit.
+ */
+template <class Card>
+constexpr int32_t cal_range_limit(int i) {
+  return (int32_t)(Card::thresholds[i] / 10) * (100L << CAL_NUM_SHIFT);
+}
+
+#define CAL_RANGE(c, r)                                                 \
+  cal_fixed<Card>(c, 6 * r), cal_fixed<Card>(c, 6 * r + 1),             \
+      cal_fixed<Card>(c, 6 * r + 2), cal_fixed<Card>(c, 6 * r + 3),     \
+      cal_fixed<Card>(c, 6 * r + 4), cal_fixed<Card>(c, 6 * r + 5)
+#define CAL_CHANNEL(c) \
+  { CAL_RANGE(c, 0), CAL_RANGE(c, 1), CAL_RANGE(c, 2) }
+
+template <class Card>
+struct CardCalibration {
+  // Pre-scaled copy of Card::amp_coeffs, indexed [chan - 1][range * 6 + term]
+  static constexpr int32_t amp[4][18] PROGMEM = {
+      CAL_CHANNEL(1), CAL_CHANNEL(2), CAL_CHANNEL(3), CAL_CHANNEL(4)};
+};
+
+template <class Card>
+constexpr int32_t CardCalibration<Card>::amp[4][18] PROGMEM;
+
+#undef CAL_CHANNEL
+#undef CAL_RANGE
+
+/**
+ * @brief Convert a frequency to the normalised Q24 polynomial variable
+ *
+ * @param freq DDS frequency in Hz (0 - 100 kHz)
+ */
+uint32_t cal_freq_q(float freq) {
+  return (uint32_t)(freq * (1L << (CAL_FREQ_SHIFT - CAL_FREQ_NORM)) + 0.5f);
+}
+
+/**
+ * @brief Q28 denominator (frequency polynomial + c5) for one range
+ *
+ * @param chan Channel number (1-4)
+ * @param range Calibration range (0-2)
+ * @param freq_q Frequency from cal_freq_q()
+ */
+template <class Card>
+int32_t cal_denominator(int chan, uint8_t range, uint32_t freq_q) {
+  const int32_t* k = CardCalibration<Card>::amp[chan - 1] + 6 * range;
+
+  // Horner: x * (K0 + x * (K1 + x * (K2 + x * K3))) + K5
+  int32_t acc = pgm_read_dword_near(k + 3);
+  for (int8_t i = 2; i >= 0; i--) {
+    acc = (int32_t)pgm_read_dword_near(k + i) +
+          (int32_t)(((int64_t)acc * freq_q) >> CAL_FREQ_SHIFT);
+  }
+  acc = (int32_t)(((int64_t)acc * freq_q) >> CAL_FREQ_SHIFT);
+  return acc + (int32_t)pgm_read_dword_near(k + 5);
+}
+
+/**
+ * @brief DGAIN word for a Q12 numerator (100 * voltage) at a given frequency
+ *
+ * Truncates towards zero, like the float conversion it replaces.
+ *
+ * @param chan Channel number (1-4)
+ * @param num_q 100 * voltage in Q12, see cal_numerator()
+ * @param freq_q Frequency from cal_freq_q()
+ */
+template <class Card>
+int16_t cal_gain_word(int chan, int32_t num_q, uint32_t freq_q) {
+  if (!cal_has_channel<Card>(chan))
+    return 0;
+
+  // Same range selection as the float fit: the first range whose limits
+  // hold the voltage, range 0 outside all of them
+  constexpr int32_t limit_1 = cal_range_limit<Card>(1);
+  constexpr int32_t limit_2 = cal_range_limit<Card>(2);
+  constexpr int32_t limit_3 = cal_range_limit<Card>(3);
+  uint8_t range = 0;
+  if (limit_1 < num_q && num_q <= limit_3)
+    range = (num_q > limit_2) ? 2 : 1;
+
+  const int32_t* k = CardCalibration<Card>::amp[chan - 1] + 6 * range;
+  int32_t num = num_q - (int32_t)pgm_read_dword_near(k + 4);
+  int32_t den = cal_denominator<Card>(chan, range, freq_q);
+  if (den <= 0)
+    return 0;
+
+  // word = num * 2^16 / den. Long division keeps this in 32 bit registers.
+  uint32_t n = (num < 0) ? -num : num;
+  uint32_t d = den;
+  uint32_t q = n / d;
+  uint32_t r = n % d;
+  for (uint8_t i = 0; i < CAL_COEFF_SHIFT - CAL_NUM_SHIFT; i++) {
+    r <<= 1;
+    q <<= 1;
+    if (r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+  if (q > 0x7fff)
+    q = 0x7fff;
+  return (num < 0) ? -(int16_t)q : (int16_t)q;
+}
+
+/**
+ * @brief Scale a voltage in mV to the Q12 numerator used by cal_gain_word()
+ */
+int32_t cal_numerator(float voltage) {
+  return (int32_t)(voltage * (100.0f * (1L << CAL_NUM_SHIFT)));
+}
+
+/*
+ * The phase offsets in config.h are resampled at compile time onto a grid of
+ * DDS tuning words with four points per octave, so the grid index comes from
+ * the bit length of the tuning word instead of log10():
+ *
+ *   tw < 8:   index = tw
+ *   tw >= 8:  index = 4 * (msb - 1) + the two bits below the msb
+ *
+ * Grid points are tuning words with only those three bits set, so the
+ * remaining low bits are the distance to the point below and linear
+ * interpolation is a multiply and a shift. Offsets are stored in 1/16 LSB
+ * of the DDSn_PW word, outside the measured range they are held constant.
+ */
+const uint8_t PHASE_CAL_POINTS = 53;  // tuning words up to 2^14 (~176 kHz)
+const uint8_t PHASE_CAL_SHIFT = 4;
+
+constexpr double cal_powi(double base, int e) {
+  return (e == 0) ? 1.0 : base * cal_powi(base, e - 1);
+}
+
+// Tuning word of measured point j
+constexpr double phase_meas_tw(int j) {
+  return 10.0 * cal_powi(PHASE_MEAS_RATIO, j + 8) * cal_pow2(24) /
+         PHASE_MEAS_FCLK;
+}
+
+// Tuning word of grid point i
+constexpr double phase_grid_tw(int i) {
+  return (i < 4) ? i : (double)((4 + (i & 3)) << ((i >> 2) - 1));
+}
+
+// Measured offset at a tuning word, linear between the points j and j + 1
+constexpr double phase_meas_at(const int16_t* offsets, double tw, int j) {
+  return (tw <= phase_meas_tw(0)) ? offsets[0]
+         : (j >= PHASE_MEAS_POINTS - 1) ? offsets[PHASE_MEAS_POINTS - 1]
+         : (tw < phase_meas_tw(j + 1))
+             ? offsets[j] + (offsets[j + 1] - offsets[j]) *
+                                (tw - phase_meas_tw(j)) /
+                                (phase_meas_tw(j + 1) - phase_meas_tw(j))
+             : phase_meas_at(offsets, tw, j + 1);
+}
+
+/**
+ * @brief Offset at grid point i in 1/16 DDSn_PW LSB
+ *
+ * @param offsets Measured offsets of the channel
+ */
+constexpr int16_t phase_fixed(const int16_t* offsets, int i) {
+  return cal_round(phase_meas_at(offsets, phase_grid_tw(i), 0) * 1e-4 *
+                   cal_pow2(16 + PHASE_CAL_SHIFT) / 360.0);
+}
+
+#define PHASE_POINTS_4(c, i)                                 \
+  phase_fixed(c, i), phase_fixed(c, i + 1), phase_fixed(c, i + 2), \
+      phase_fixed(c, i + 3)
+#define PHASE_POINTS_16(c, i)                                \
+  PHASE_POINTS_4(c, i), PHASE_POINTS_4(c, i + 4), PHASE_POINTS_4(c, i + 8), \
+      PHASE_POINTS_4(c, i + 12)
+#define PHASE_CHANNEL(c)                                                 \
+  {                                                                      \
+    PHASE_POINTS_16(c, 0), PHASE_POINTS_16(c, 16), PHASE_POINTS_16(c, 32), \
+        PHASE_POINTS_4(c, 48), phase_fixed(c, 52)                        \
+  }
+
+// Resampled copy of dac_phase_offsets, indexed [chan - 1][grid point]
+constexpr int16_t dac_phase_fixed[4][PHASE_CAL_POINTS] PROGMEM = {
+    PHASE_CHANNEL(dac_phase_offsets[0]), PHASE_CHANNEL(dac_phase_offsets[1]),
+    PHASE_CHANNEL(dac_phase_offsets[2]), PHASE_CHANNEL(dac_phase_offsets[3])};
+
+#undef PHASE_CHANNEL
+#undef PHASE_POINTS_16
+#undef PHASE_POINTS_4
+
+/**
+ * @brief Phase offset of a channel against channel 1 at a tuning word
+ *
+ * @param chan Channel number (1-4)
+ * @param tw DDS tuning word
+ *
+ * @returns Offset in DDSn_PW LSB, to subtract from the phase word
+ */
+int16_t cal_phase_offset(int chan, uint32_t tw) {
+  const int16_t* k = dac_phase_fixed[chan - 1];
+  uint8_t index = tw;
+  uint8_t shift = 0;
+  if (tw >= 8) {
+    uint8_t msb = 3;
+    while (tw >> (msb + 1))
+      msb++;
+    shift = msb - 2;
+    index = 4 * (msb - 1) + ((tw >> shift) & 3);
+  }
+  if (index >= PHASE_CAL_POINTS - 1) {
+    int16_t last = pgm_read_word_near(k + PHASE_CAL_POINTS - 1);
+    return (last + (1 << (PHASE_CAL_SHIFT - 1))) >> PHASE_CAL_SHIFT;
+  }
+
+  int16_t lo = pgm_read_word_near(k + index);
+  int16_t hi = pgm_read_word_near(k + index + 1);
+  uint16_t frac = tw & ((1UL << shift) - 1);
+  int32_t off = ((int32_t)lo << shift) + (int32_t)(hi - lo) * frac;
+  shift += PHASE_CAL_SHIFT;
+  return (off + (1L << (shift - 1))) >> shift;
+}
+
+#endif
@@ -8,15 +8,34 @@
 #define COMMAND_HANDLERS_H
 
 #include <Vrekrer_scpi_parser.h>
+#include "binary_protocol.h"
+#include "command_stats.h"
 #include "global_error.h"
 #include "lcd_view.h"
+#include "line_queue.h"
 #include "model.h"
+#include "presets.h"
+#include "ram_guard.h"
+#include "scheduler.h"
+#include "sequencer.h"
+#include "serial_link.h"
+#include "sram_upload.h"
+#include "sweep.h"
+#include "trigger.h"
 
 extern Model model;
 extern LCDView view;
-extern SCPI_Parser parser;
+extern LineQueue line_queue;
 extern GlobalError system_error;
 extern ViewState viewState;
+extern BinaryProtocol binary;
+extern SerialLink serialLink;
+extern SramUpload upload;
+extern Sequencer sequencer;
+extern Trigger trigger;
+extern RamGuard ram_guard;
+extern Scheduler scheduler;
+extern uint8_t task_link;
 
 /*********************************************************/
 // Helper Functions
@@ -41,16 +60,183 @@ int check_param_num(int expected, int received) {
 }
 
 /**
- * @brief Get the suffix of a command as an integer
- * @param commands SCPI Commands object
- * @return The suffix as an integer
+ * @brief Write a value with two decimals as a fixed-width field
+ *
+ * Integer formatting, cheaper than printing floats.
+ *
+ * @param digits Integer digits, zero padded
+ * @param sign Always start with + or -
+ * @return End of the field
+ */
+char* put_fixed(char* out, float value, uint8_t digits, bool sign) {
+  int32_t hundredths = (int32_t)(value * 100 + ((value < 0) ? -0.5f : 0.5f));
+  if (sign || hundredths < 0)
+    *out++ = (hundredths < 0) ? '-' : '+';
+  uint32_t mag = (hundredths < 0) ? -hundredths : hundredths;
+  char* end = out + digits + 3;
+  char* p = end;
+  *--p = '0' + mag % 10;
+  mag /= 10;
+  *--p = '0' + mag % 10;
+  mag /= 10;
+  *--p = '.';
+  while (p > out) {
+    *--p = '0' + mag % 10;
+    mag /= 10;
+  }
+  return end;
+}
+
+/**
+ * @brief Read 4 channel voltages starting at params[first]
+ * @return 0 if every voltage is in range, 1 otherwise
+ */
+int parse_voltages(SCPI_P& params, int first, float* volts) {
+  for (int i = 0; i < 4; i++) {
+    volts[i] = atof(params[first + i]);
+    if (!model.voltageInRange(volts[i])) {
+      system_error.set_error(GenericError::ParamOutOfRange);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Read 4 channel phases starting at params[first]
+ * @return 0 if every phase is in range, 1 otherwise
  */
-int get_int_suffix(SCPI_C& commands) {
-  String header = String(commands.First());
-  int suffix = -1;
-  // Scan past non-numeric characters
-  sscanf(header.c_str(), "%*[^0-9]%u", &suffix);
-  return suffix;
+int parse_phases(SCPI_P& params, int first, float* phases) {
+  for (int i = 0; i < 4; i++) {
+    phases[i] = atof(params[first + i]);
+    if (phases[i] < -180 || phases[i] > 180) {
+      system_error.set_error(GenericError::ParamOutOfRange);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Mirror an applied multi-channel state into the view
+ */
+void show_channels(float* volts, float* phases) {
+  for (int i = 0; i < 4; i++) {
+    if (volts != NULL)
+      viewState.setVolts(i + 1, &volts[i]);
+    if (phases != NULL)
+      viewState.setPhase(i + 1, &phases[i]);
+  }
+  viewState.freq = model.getFreq();
+  if (viewState.mode != ViewState::Mode::REMOTE)
+    viewState.update = true;
+}
+
+/*********************************************************/
+// Controller Operations
+// Shared by the SCPI handlers and the binary protocol
+/*********************************************************/
+
+/**
+ * @brief Set the voltage on a channel and mirror it in the view
+ * @return 0 if the voltage was set, 1 otherwise
+ */
+int set_channel_voltage(int chan, float voltage) {
+  if (chan < 1 || chan > 4) {
+    system_error.set_error(GenericError::BadSuffix);
+    return 1;
+  }
+  if (!model.setVoltage(chan, voltage))
+    return 1;
+  viewState.setVolts(chan, &voltage);
+  return 0;
+}
+
+/**
+ * @brief Set the phase on a channel and mirror it in the view
+ * @return 0 if the phase was set, 1 otherwise
+ */
+int set_channel_phase(int chan, float phase) {
+  if (chan < 1 || chan > 4) {
+    system_error.set_error(GenericError::BadSuffix);
+    return 1;
+  }
+  if (phase < -180 || phase > 180) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return 1;
+  }
+  model.setPhase(chan, phase);
+  viewState.setPhase(chan, &phase);
+  return 0;
+}
+
+/**
+ * @brief Set the DDS frequency and mirror it in the view
+ * @return 0 if the frequency was set, 1 otherwise
+ */
+int set_frequency(float freq) {
+  if (freq < 0 || freq > 100000) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return 1;
+  }
+  model.setFreq(freq);
+  viewState.freq = model.getFreq();
+  return 0;
+}
+
+/**
+ * @brief Apply pending settings and refresh the view
+ */
+void update_outputs() {
+  model.update();
+  if (viewState.mode != ViewState::Mode::REMOTE)
+    viewState.update = true;
+}
+
+/**
+ * @brief Store the current setup in a preset slot
+ * @return 0 if the setup was stored, 1 otherwise
+ */
+int save_preset(int slot) {
+  if (slot < 0 || slot >= PRESET_SLOTS) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return 1;
+  }
+  Preset preset;
+  preset.freq = model.getFreq();
+  for (int i = 0; i < 4; i++) {
+    preset.volts[i] = model.getVoltage(i + 1);
+    preset.phases[i] = model.getPhase(i + 1);
+  }
+  preset.voltage_mask =
+      model.prepare(preset.words, preset.freq, NULL, preset.phases);
+  ViewState::Mode mode = (viewState.mode == ViewState::Mode::ERROR)
+                             ? viewState.last_mode
+                             : viewState.mode;
+  preset.display_mode = static_cast<uint8_t>(mode);
+  write_preset(slot, preset);
+  return 0;
+}
+
+/**
+ * @brief Restore a stored setup with a single register commit
+ * @return 0 if the setup was restored, 1 otherwise
+ */
+int recall_preset(int slot) {
+  if (slot < 0 || slot >= PRESET_SLOTS) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return 1;
+  }
+  Preset preset;
+  if (!read_preset(slot, preset)) {
+    system_error.set_error(GenericError::EmptyPreset);
+    return 1;
+  }
+  sequencer.stop();
+  model.restore(preset.volts, preset.voltage_mask, preset.words);
+  show_channels(preset.volts, preset.phases);
+  viewState.setMode(static_cast<ViewState::Mode>(preset.display_mode));
+  return 0;
 }
 
 /*********************************************************/
@@ -60,85 +246,383 @@ int get_int_suffix(SCPI_C& commands) {
 /**
  * @brief Send identification string over interface
  */
-void handleIdentify(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleIdentify(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
   interface.println(F("BARRERA, ACDAC02, AD9106, 2.00"));
 }
 
 /**
- * @brief Reset the model
+ * @brief Reset the model, and stop anything that would write to it later
  */
-void handleReset(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleReset(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
+  sequencer.clear();
+  trigger.configure(TriggerSource::BUS, RISING, TriggerAction::NONE);
   model.reset();
   view.reset();
   viewState.reset();
 }
 
+/**
+ * @brief Save the current setup, *SAV <slot>
+ */
+void handleSave(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+  save_preset(strtol(params[0], NULL, 10));
+}
+
+/**
+ * @brief Recall a saved setup, *RCL <slot>
+ */
+void handleRecall(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+  recall_preset(strtol(params[0], NULL, 10));
+}
+
 // Pattern Handlers
-void handleStop(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleStop(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
   model.stop_pattern();
 }
 
-void handleStart(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleStart(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
   model.start();
   viewState.update = true;
 }
 
-void handleUpdate(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleUpdate(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
-  model.update();
-  if (viewState.mode != ViewState::Mode::REMOTE)
-    viewState.update = true;
+  update_outputs();
 }
 
 /**
  * @brief Set the voltage on a channel
  */
-void handleSetVoltage(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleSetVoltage(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(1, params.Size()))
     return;
 
-  int chan = get_int_suffix(commands);
-  if (chan < 1 | chan > 4) {
+  set_channel_voltage(suffix, atof(params[0]));
+}
+
+/**
+ * @brief Get the voltage requested on a channel
+ */
+void handleGetVoltage(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+
+  if (suffix < 1 || suffix > 4) {
     system_error.set_error(GenericError::BadSuffix);
     return;
   }
+  interface.println(model.getVoltage(suffix));
+}
+
+/*********************************************************/
+// Multi-channel Commands
+/*********************************************************/
 
-  float voltage = atof(params[0]);
-  if (model.setVoltage(chan, voltage)) {
-    viewState.setVolts(chan, &voltage);
+/**
+ * @brief Set the voltage on all channels and apply them together
+ */
+void handleSetAllVoltage(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(4, params.Size()))
+    return;
+
+  float volts[4];
+  if (parse_voltages(params, 0, volts))
+    return;
+  model.setChannels(volts, NULL);
+  show_channels(volts, NULL);
+}
+
+/**
+ * @brief Set the phase on all channels and apply them together
+ */
+void handleSetAllPhase(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(4, params.Size()))
+    return;
+
+  float phases[4];
+  if (parse_phases(params, 0, phases))
+    return;
+  model.setChannels(NULL, phases);
+  show_channels(NULL, phases);
+}
+
+/**
+ * @brief Set frequency, all voltages and all phases in one update
+ *
+ * Parameters: freq, v1, v2, v3, v4, p1, p2, p3, p4
+ */
+void handleSetAllState(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(9, params.Size()))
+    return;
+
+  float freq = atof(params[0]);
+  if (freq < 0 || freq > 100000) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
   }
+  float volts[4];
+  float phases[4];
+  if (parse_voltages(params, 1, volts) || parse_phases(params, 5, phases))
+    return;
+  model.setChannels(volts, phases, freq);
+  show_channels(volts, phases);
 }
 
+/*********************************************************/
+// Sequence Commands
+// Sweeps and lists share the Sequencer table
+/*********************************************************/
+
 /**
- * @brief Get the voltage on a channel
+ * @brief Load a sweep from <start>,<stop>,<points>,<LIN|LOG>,<dwell ms>
+ */
+void configure_sweep(SweepTarget target, SCPI_P& params) {
+  if (check_param_num(5, params.Size()))
+    return;
+
+  bool log_spacing;
+  if (strncasecmp(params[3], "LIN", 3) == 0) {
+    log_spacing = false;
+  } else if (strncasecmp(params[3], "LOG", 3) == 0) {
+    log_spacing = true;
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
+    return;
+  }
+  long points = strtol(params[2], NULL, 10);
+  float dwell_ms = atof(params[4]);
+  if (points < 0 || points > 255 || dwell_ms < 0 || dwell_ms > 60000) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+  load_sweep(sequencer, model, target, atof(params[0]), atof(params[1]),
+             points, log_spacing, (unsigned long)(dwell_ms * 1000));
+}
+
+void handleSweepFreq(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  configure_sweep(SweepTarget::FREQUENCY, params);
+}
+
+void handleSweepVolt(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  configure_sweep(SweepTarget::VOLTAGE, params);
+}
+
+void handleListClear(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  sequencer.clear();
+}
+
+/**
+ * @brief Append a list entry
  *
- * TODO: get from model instead of viewState
+ * Parameters: dwell (ms), freq, v1, v2, v3, v4, p1, p2, p3, p4
+ */
+void handleListAppend(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(10, params.Size()))
+    return;
+
+  float dwell_ms = atof(params[0]);
+  float freq = atof(params[1]);
+  if (dwell_ms < 0 || dwell_ms > 60000 || freq < 0 || freq > 100000) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+  float volts[4];
+  float phases[4];
+  if (parse_voltages(params, 2, volts) || parse_phases(params, 6, phases))
+    return;
+
+  // A list replaces a sweep, entries set the DGAIN word of every channel
+  if (sequencer.holdsSweep())
+    sequencer.clear();
+  SequenceEntry* entry = sequencer.append((unsigned long)(dwell_ms * 1000));
+  if (entry != NULL)
+    model.prepare(entry->words, freq, volts, phases);
+}
+
+/**
+ * @brief Set how many times the list plays, 0 for endless
  */
-void handleGetVoltage(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleListCount(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+  long count = strtol(params[0], NULL, 10);
+  if (count < 0 || count > 0xffff) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+  sequencer.setLoops(count);
+}
+
+void handleSequenceStart(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
+  sequencer.start();
+}
 
-  int chan = get_int_suffix(commands);
-  if (chan < 1 | chan > 4) {
-    system_error.set_error(GenericError::BadSuffix);
+/**
+ * @brief Stop playback, leaving the current entry applied
+ */
+void handleSequenceStop(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  sequencer.stop();
+  viewState.freq = model.getFreq();
+  if (viewState.mode != ViewState::Mode::REMOTE)
+    viewState.update = true;
+}
+
+/**
+ * @brief Print "<running>,<next entry>,<entries>,<passes done>"
+ */
+void handleSequenceState(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  interface.print(sequencer.isRunning() ? 1 : 0);
+  interface.print(',');
+  interface.print(sequencer.position());
+  interface.print(',');
+  interface.print(sequencer.size());
+  interface.print(',');
+  interface.println(sequencer.passesDone());
+}
+
+/*********************************************************/
+// Trigger Commands
+/*********************************************************/
+
+/**
+ * @brief Set the trigger source, BUS (*TRG) or EXTernal (pin 2)
+ */
+void handleTrigSource(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+
+  TriggerSource source;
+  if (strncasecmp(params[0], "BUS", 3) == 0) {
+    source = TriggerSource::BUS;
+  } else if (strncasecmp(params[0], "EXT", 3) == 0) {
+    source = TriggerSource::EXTERNAL;
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
     return;
   }
-  interface.println(viewState.getVolts(chan));
+  trigger.configure(source, trigger.mode, trigger.action);
+}
+
+/**
+ * @brief Set the active edge, POSitive, NEGative or EITHer
+ */
+void handleTrigSlope(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+
+  int mode;
+  if (strncasecmp(params[0], "POS", 3) == 0) {
+    mode = RISING;
+  } else if (strncasecmp(params[0], "NEG", 3) == 0) {
+    mode = FALLING;
+  } else if (strncasecmp(params[0], "EITH", 4) == 0) {
+    mode = CHANGE;
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
+    return;
+  }
+  trigger.configure(trigger.source, mode, trigger.action);
+}
+
+/**
+ * @brief Set what a trigger does: NONE, STARt, STOP, UPDate or STEP
+ *
+ * UPDate holds every pattern update until the trigger. STEP advances a
+ * SOURce:LIST or SOURce:SWEep started with :STARt by one entry per trigger.
+ */
+void handleTrigAction(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+
+  TriggerAction action;
+  if (strncasecmp(params[0], "NONE", 4) == 0) {
+    action = TriggerAction::NONE;
+  } else if (strncasecmp(params[0], "STAR", 4) == 0) {
+    action = TriggerAction::START;
+  } else if (strncasecmp(params[0], "STOP", 4) == 0) {
+    action = TriggerAction::STOP;
+  } else if (strncasecmp(params[0], "UPD", 3) == 0) {
+    action = TriggerAction::UPDATE;
+  } else if (strncasecmp(params[0], "STEP", 4) == 0) {
+    action = TriggerAction::STEP;
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
+    return;
+  }
+  trigger.configure(trigger.source, trigger.mode, action);
+}
+
+/**
+ * @brief Print "<source>,<slope>,<action>,<triggers received>"
+ */
+void handleGetTrig(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+
+  interface.print(trigger.source == TriggerSource::BUS ? F("BUS") : F("EXT"));
+  interface.print(',');
+  interface.print(trigger.mode == RISING    ? F("POS")
+                  : trigger.mode == FALLING ? F("NEG")
+                                            : F("EITH"));
+  interface.print(',');
+  switch (trigger.action) {
+    case TriggerAction::START:
+      interface.print(F("STAR"));
+      break;
+    case TriggerAction::STOP:
+      interface.print(F("STOP"));
+      break;
+    case TriggerAction::UPDATE:
+      interface.print(F("UPD"));
+      break;
+    case TriggerAction::STEP:
+      interface.print(F("STEP"));
+      break;
+    default:
+      interface.print(F("NONE"));
+  }
+  interface.print(',');
+  noInterrupts();  // the ISR counts, and a 16 bit read takes two loads
+  uint16_t count = trigger.count;
+  interrupts();
+  interface.println(count);
+}
+
+/**
+ * @brief Bus trigger, ignored unless the trigger source is BUS
+ */
+void handleBusTrigger(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  if (trigger.source == TriggerSource::BUS)
+    trigger.fire();
 }
 
 /**
  * @brief Get the value of a register on the AD9106
  */
-void handleGetReg(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleGetReg(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(1, params.Size()))
     return;
 
@@ -147,14 +631,22 @@ void handleGetReg(SCPI_C commands, SCPI_P params, Stream& interface) {
   interface.println(val, HEX);
 }
 
+/**
+ * @brief Reload the model's register shadow from the AD9106
+ */
+void handleSyncReg(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  model.resync();
+}
+
 /**
  * @brief Set the value of a register on the AD9106
  */
-void handleSetReg(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleSetReg(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(2, params.Size()))
     return;
 
-  model.stop_pattern();
   uint16_t add = (uint16_t)strtol(params[0], NULL, 16);
   int16_t val = (int16_t)strtol(params[1], NULL, 16);
   model.writeReg(add, val);
@@ -163,24 +655,17 @@ void handleSetReg(SCPI_C commands, SCPI_P params, Stream& interface) {
 /**
  * @brief Set the frequency
  */
-void handleSetFreq(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleSetFreq(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(1, params.Size()))
     return;
 
-  float freq = atof(params.First());
-  if (freq < 0 || freq > 100000) {
-    system_error.set_error(GenericError::ParamOutOfRange);
-    return;
-  }
-
-  model.setFreq(freq);
-  viewState.freq = model.getFreq();
+  set_frequency(atof(params.First()));
 }
 
 /**
  * @brief Get the frequency
  */
-void handleGetFreq(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleGetFreq(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
   float freq = model.getFreq();
@@ -190,37 +675,471 @@ void handleGetFreq(SCPI_C commands, SCPI_P params, Stream& interface) {
 /**
  * @brief Set the phase of a channel
  */
-void handleSetPhase(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleSetPhase(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(1, params.Size()))
     return;
 
-  int chnl = get_int_suffix(commands);
-  if (chnl < 1 | chnl > 4) {
+  set_channel_phase(suffix, atof(params.First()));
+}
+
+/**
+ * @brief Get the phase of a channel
+ */
+void handleGetPhase(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  if (suffix < 1 || suffix > 4) {
+    system_error.set_error(GenericError::BadSuffix);
+    return;
+  }
+  interface.println(model.getPhase(suffix));
+}
+
+/**
+ * @brief Print the whole instrument state on one line
+ *
+ * "FFFFFF.FF,VVV.VV x4,+PPP.PP x4,R,M,E": frequency (Hz), requested channel
+ * voltages (mV) and phases (degrees), pattern running (0/1), display mode
+ * and errors in the queue. Every field has a fixed width.
+ */
+void handleGetState(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+
+  char line[80];
+  char* p = put_fixed(line, model.getFreq(), 6, false);
+  for (int chnl = 1; chnl < 5; chnl++) {
+    *p++ = ',';
+    p = put_fixed(p, model.getVoltage(chnl), 3, false);
+  }
+  for (int chnl = 1; chnl < 5; chnl++) {
+    *p++ = ',';
+    p = put_fixed(p, model.getPhase(chnl), 3, true);
+  }
+  *p++ = ',';
+  *p++ = model.isRunning() ? '1' : '0';
+  *p++ = ',';
+  *p++ = '0' + static_cast<uint8_t>(viewState.mode);
+  *p++ = ',';
+  int errors = system_error.error_count();
+  *p++ = '0' + (errors > 9 ? 9 : errors);
+  *p = '\0';
+  interface.println(line);
+}
+
+/**
+ * @brief Print SRAM use in bytes on one line
+ *
+ * "free,min free,stack,heap,static,model,view,viewState,input,errors,
+ * sequencer,stats": the gap between heap and stack now and the smallest
+ * seen, the stack high-water mark, the heap, all globals together, then the
+ * largest of them (stats is 0 without CMD_STATS).
+ */
+void handleGetMemory(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+
+  ram_guard.check();
+#if CMD_STATS
+  const int stats_size = cmd_stats.ramSize();
+#else
+  const int stats_size = 0;
+#endif
+  const int sizes[] = {free_ram(),         ram_guard.min_free,
+                       stack_high_water(), heap_size(),
+                       static_ram(),       sizeof(model),
+                       sizeof(view),       sizeof(viewState),
+                       sizeof(line_queue), sizeof(system_error),
+                       sizeof(sequencer),  stats_size};
+  for (uint8_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    if (i > 0)
+      interface.print(',');
+    interface.print(sizes[i]);
+  }
+  interface.println();
+}
+
+/**
+ * @brief Print the scheduled tasks and their worst run times
+ *
+ * One line per task, "<name>,<priority>,<period ms>,<budget us>,
+ * <worst us>,<overruns>", then "pass,<worst pass us>" and "END". Kept since
+ * boot.
+ */
+void handleGetTasks(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  for (uint8_t i = 0; i < scheduler.count(); i++) {
+    const Task& task = scheduler.task(i);
+    interface.print(task.name);
+    interface.print(',');
+    interface.print(task.priority);
+    interface.print(',');
+    interface.print(task.period_ms);
+    interface.print(',');
+    interface.print(task.budget_us);
+    interface.print(',');
+    interface.print(task.worst_us);
+    interface.print(',');
+    interface.println(task.overruns);
+  }
+  interface.print(F("pass,"));
+  interface.println(scheduler.worst_pass_us);
+  interface.println(F("END"));
+}
+
+/**
+ * @brief Time the fixed-point calibration against the float reference
+ *
+ * Prints "<float word>,<fixed word>,<float us/call>,<fixed us/call>"
+ */
+void handleCalBenchmark(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(2, params.Size()))
+    return;
+
+  int chan = strtol(params[0], NULL, 10);
+  if (chan < 1 | chan > 4) {
     system_error.set_error(GenericError::BadSuffix);
     return;
   }
+  float voltage = atof(params[1]);
+
+  const int reps = 100;
+  volatile int16_t float_word = 0;
+  volatile int16_t fixed_word = 0;
+
+  unsigned long start = micros();
+  for (int i = 0; i < reps; i++)
+    float_word = model.v_to_addr_float(voltage, chan);
+  unsigned long float_us = micros() - start;
+
+  start = micros();
+  for (int i = 0; i < reps; i++)
+    fixed_word = model.v_to_addr(voltage, chan);
+  unsigned long fixed_us = micros() - start;
+
+  interface.print(float_word);
+  interface.print(',');
+  interface.print(fixed_word);
+  interface.print(',');
+  interface.print((float)float_us / reps);
+  interface.print(',');
+  interface.println((float)fixed_us / reps);
+}
+
+#if CMD_STATS
+/**
+ * @brief Print the per-command timing statistics, then clear them
+ *
+ * One line per timed section that ran since the last query:
+ * "<name>,<count>,<min us>,<mean us>,<max us>,<b0>,...,<b3>"
+ */
+void handleGetStats(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  cmd_stats.print(interface);
+  interface.println(F("END"));
+  cmd_stats.reset();
+}
+#endif
 
-  float phase = atof(params.First());
-  if (phase < -180 | phase > 180) {
+/*********************************************************/
+// Serial Link
+/*********************************************************/
+
+/**
+ * @brief Acknowledge at the current baud rate, then switch to a new one
+ *
+ * The new rate must be confirmed with SYS:COMM:BAUD:CONF, see serial_link.h
+ */
+void handleSetBaud(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(1, params.Size()))
+    return;
+
+  unsigned long rate = strtoul(params[0], NULL, 10);
+  if (!serialLink.isSupported(rate)) {
     system_error.set_error(GenericError::ParamOutOfRange);
     return;
   }
-  model.setPhase(chnl, phase);
-  viewState.setPhase(chnl, &phase);
+  interface.println(rate);
+  serialLink.change(rate);
+  scheduler.once(task_link, LINK_CONFIRM_TIMEOUT + 1);
 }
 
 /**
- * @brief Get the phase of a channel
+ * @brief Get the current baud rate
+ */
+void handleGetBaud(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  interface.println(serialLink.rate());
+}
+
+/**
+ * @brief Handshake keeping a new baud rate
+ */
+void handleConfirmBaud(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  serialLink.confirm();
+  interface.println(serialLink.rate());
+}
+
+/**
+ * @brief Store the current baud rate as the power-on default
+ */
+void handleSaveBaud(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  if (serialLink.isPending()) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+  serialLink.save();
+}
+
+/*********************************************************/
+// Waveform Commands
+// Pattern SRAM upload or synthesis, and per channel source
+/*********************************************************/
+
+/**
+ * @brief Upload words to the pattern SRAM, SOURce:TRACe:LOAD <start>,<words>
+ *
+ * Stops a running sequence and switches the interface to chunks until the
+ * upload is over (see sram_upload.h).
+ */
+void handleTraceLoad(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(2, params.Size()))
+    return;
+  long start = strtol(params[0], NULL, 10);
+  long words = strtol(params[1], NULL, 10);
+  if (start < 0 || words < 1 || start + words > SRAM_WORDS) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+  sequencer.stop();
+  model.beginSram();
+  line_queue.pause(true);
+  interface.print(F("READY "));
+  interface.println(UPLOAD_CHUNK_WORDS);
+  interface.flush();
+  upload.begin(start, words);
+}
+
+/**
+ * @brief Write one uploaded chunk
+ */
+void handleUploadChunk(uint16_t addr, const uint8_t* data, uint8_t words) {
+  model.writeSram(addr, data, words);
+}
+
+/**
+ * @brief Return to SCPI after an upload
+ */
+void handleUploadDone() {
+  model.endSram();
+  line_queue.pause(false);
+}
+
+/**
+ * @brief Compute one period of a waveform into the pattern SRAM,
+ * SOURce:TRACe:SHAPe <start>,<words>,<shape>[,...]
+ *
+ * Shapes: SINE, TRIangle, RAMP, SQUare[,<duty %>] and
+ * HARMonics,<a1>[,<a2>...] with up to SYNTH_HARMONICS amplitudes in % of
+ * full scale (negative inverts a term).
+ */
+void handleTraceShape(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (params.Size() < 3) {
+    system_error.set_error(GenericError::TooFewParams);
+    return;
+  }
+  long start = strtol(params[0], NULL, 10);
+  long words = strtol(params[1], NULL, 10);
+  if (start < 0 || words < 1 || start + words > SRAM_WORDS) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return;
+  }
+
+  SynthWave wave;
+  uint8_t extra = params.Size() - 3;
+  if (strncasecmp(params[2], "SIN", 3) == 0) {
+    wave.shape = SynthShape::SINE;
+  } else if (strncasecmp(params[2], "TRI", 3) == 0) {
+    wave.shape = SynthShape::TRIANGLE;
+  } else if (strncasecmp(params[2], "RAMP", 4) == 0) {
+    wave.shape = SynthShape::RAMP;
+  } else if (strncasecmp(params[2], "SQU", 3) == 0) {
+    wave.shape = SynthShape::SQUARE;
+    long duty = (extra > 0) ? strtol(params[3], NULL, 10) : 50;
+    if (extra > 1) {
+      system_error.set_error(GenericError::TooManyParams);
+      return;
+    }
+    if (duty < 1 || duty > 99) {
+      system_error.set_error(GenericError::ParamOutOfRange);
+      return;
+    }
+    wave.duty = duty * 65536 / 100;
+    extra = 0;
+  } else if (strncasecmp(params[2], "HARM", 4) == 0) {
+    wave.shape = SynthShape::HARMONICS;
+    if (extra < 1 || extra > SYNTH_HARMONICS) {
+      system_error.set_error(extra < 1 ? GenericError::TooFewParams
+                                       : GenericError::TooManyParams);
+      return;
+    }
+    for (uint8_t k = 0; k < extra; k++) {
+      long percent = strtol(params[3 + k], NULL, 10);
+      if (percent < -100 || percent > 100) {
+        system_error.set_error(GenericError::ParamOutOfRange);
+        return;
+      }
+      wave.amps[k] = percent * 32767 / 100;
+    }
+    wave.harmonics = extra;
+    extra = 0;
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
+    return;
+  }
+  if (extra > 0) {
+    system_error.set_error(GenericError::TooManyParams);
+    return;
+  }
+  sequencer.stop();
+  model.synthSram(start, words, wave);
+}
+
+/**
+ * @brief Select what a channel plays, CHANnel#:SOURce SINE or
+ * CHANnel#:SOURce SRAM,<start>,<stop> for SRAM words start to stop
+ */
+void handleSetSource(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (suffix < 1 || suffix > 4) {
+    system_error.set_error(GenericError::BadSuffix);
+    return;
+  }
+  if (params.Size() > 0 && strncasecmp(params[0], "SIN", 3) == 0) {
+    if (check_param_num(1, params.Size()))
+      return;
+    model.setSineSource(suffix);
+  } else if (params.Size() > 0 && strncasecmp(params[0], "SRAM", 4) == 0) {
+    if (check_param_num(3, params.Size()))
+      return;
+    long start = strtol(params[1], NULL, 10);
+    long stop = strtol(params[2], NULL, 10);
+    if (start < 0 || stop < start || stop >= SRAM_WORDS) {
+      system_error.set_error(GenericError::ParamOutOfRange);
+      return;
+    }
+    model.setSramSource(suffix, start, stop);
+  } else if (params.Size() == 0) {
+    system_error.set_error(GenericError::TooFewParams);
+  } else {
+    system_error.set_error(GenericError::UnknownParam);
+  }
+}
+
+/**
+ * @brief Print what a channel plays, "SINE" or "SRAM,<start>,<stop>"
  */
-void handleGetPhase(SCPI_C commands, SCPI_P params, Stream& interface) {
+void handleGetSource(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(0, params.Size()))
     return;
-  int chnl = get_int_suffix(commands);
-  if (chnl < 1 | chnl > 4) {
+  if (suffix < 1 || suffix > 4) {
     system_error.set_error(GenericError::BadSuffix);
     return;
   }
-  interface.println(model.getPhase(chnl));
+  if (!model.isSramSource(suffix)) {
+    interface.println(F("SINE"));
+    return;
+  }
+  interface.print(F("SRAM,"));
+  interface.print(model.getSramStart(suffix));
+  interface.print(',');
+  interface.println(model.getSramStop(suffix));
+}
+
+/*********************************************************/
+// Binary Protocol
+/*********************************************************/
+
+/**
+ * @brief Switch the interface to binary frames (see binary_protocol.h)
+ */
+void handleBinaryMode(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  line_queue.pause(true);
+  interface.println(F("BINARY"));
+  interface.flush();
+  binary.begin();
+}
+
+/**
+ * @brief Run one binary request against the controller operations
+ */
+void handleBinaryFrame(const BinaryFrame& request, BinaryFrame& reply) {
+  int chan = request.channel;
+  float value = (float)request.value / BIN_SCALE;
+  int failed = 0;
+
+  switch (request.opcode) {
+    case BIN_NOP:
+      break;
+    case BIN_SET_VOLT:
+      failed = set_channel_voltage(chan, value);
+      break;
+    case BIN_SET_PHASE:
+      failed = set_channel_phase(chan, value);
+      break;
+    case BIN_SET_FREQ:
+      failed = set_frequency(value);
+      break;
+    case BIN_UPDATE:
+      update_outputs();
+      break;
+    case BIN_START:
+      model.start();
+      viewState.update = true;
+      break;
+    case BIN_STOP:
+      model.stop_pattern();
+      break;
+    case BIN_GET_VOLT:
+    case BIN_GET_PHASE:
+      if (chan < 1 || chan > 4) {
+        system_error.set_error(GenericError::BadSuffix);
+        failed = 1;
+        break;
+      }
+      value = (request.opcode == BIN_GET_VOLT) ? model.getVoltage(chan)
+                                               : model.getPhase(chan);
+      reply.value = (int32_t)round(value * BIN_SCALE);
+      break;
+    case BIN_GET_FREQ:
+      reply.value = (int32_t)round(model.getFreq() * BIN_SCALE);
+      break;
+    case BIN_GET_ERROR:
+      reply.value = system_error.get_error();
+      if (reply.value != 0)
+        viewState.setMode(viewState.last_mode);
+      break;
+    case BIN_EXIT:
+      binary.end();
+      line_queue.pause(false);
+      break;
+    default:
+      system_error.set_error(GenericError::UnknownParam);
+      failed = 1;
+  }
+
+  if (failed) {
+    reply.channel = 1;
+    reply.value = system_error.get_error(true);
+  }
 }
 
 /*********************************************************/
@@ -230,7 +1149,7 @@ void handleGetPhase(SCPI_C commands, SCPI_P params, Stream& interface) {
 /**
  * @brief Change the display mode of the lcd
  */
-void changeMode(SCPI_C commands, SCPI_P params, Stream& interface) {
+void changeMode(uint8_t suffix, SCPI_P& params, Stream& interface) {
   if (check_param_num(1, params.Size()))
     return;
   int mode = strtol(params[0], NULL, 10);
@@ -251,7 +1170,7 @@ void changeMode(SCPI_C commands, SCPI_P params, Stream& interface) {
 /**
  * @brief Get the last error (most recent) from the buffer
  */
-void GetLastEror(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+void GetLastEror(uint8_t suffix, SCPI_P& parameters, Stream& interface) {
   if (check_param_num(0, parameters.Size()))
     return;
   int err_code = system_error.get_error();
@@ -266,22 +1185,32 @@ void GetLastEror(SCPI_C commands, SCPI_P parameters, Stream& interface) {
 }
 
 /**
- * @brief Handler for SCPI errors
+ * @brief Drain the whole error log in one line, oldest first
+ *
+ * "<code>,<count>,<ms>;..." with the time of the last occurrence in
+ * millis(), or "0,0,0" if the log is empty.
  */
-void SCPIErrorHandler(SCPI_C commands, SCPI_P parameters, Stream& interface) {
-  // This function is called every time a SCPI error occurs
-
-  /* For BufferOverflow errors, the rest of the message, still in the
-  interface buffer or not yet received, will be processed later and probably
-  trigger another kind of error. Here we flush the incomming message*/
-  system_error.set_error(parser.last_error);
-  if (parser.last_error == SCPI_Parser::ErrorCode::BufferOverflow) {
-    delay(2);
-    while (interface.available()) {
-      delay(2);
-      interface.read();
-    }
+void handleGetAllErrors(uint8_t suffix, SCPI_P& params, Stream& interface) {
+  if (check_param_num(0, params.Size()))
+    return;
+  int count = system_error.error_count();
+  if (count == 0) {
+    interface.println(F("0,0,0"));
+    return;
+  }
+  for (int i = 0; i < count; i++) {
+    const ErrorEvent& event = system_error.event(i);
+    if (i > 0)
+      interface.print(';');
+    interface.print(unpack_error(event.code));
+    interface.print(',');
+    interface.print(event.count);
+    interface.print(',');
+    interface.print(event.time);
   }
-};
+  interface.println();
+  system_error.clear();
+  viewState.setMode(viewState.last_mode);
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+/******************************************************************************
+    @file:  command_stats.h
+
+    @brief: Per-command execution time statistics, see CMD_STATS in config.h
+******************************************************************************/
+
+#ifndef COMMAND_STATS_H
+#define COMMAND_STATS_H
+
+#include "Arduino.h"
+#include "config.h"
+
+#if CMD_STATS
+
+const uint8_t STAT_NAMED = 2;    // sections with a stored name, see add()
+const uint8_t STAT_POOL = 12;    // sections timed between two queries
+const uint8_t STAT_BUCKETS = 4;  // bucket i holds times below 64 * 16^i us
+const uint8_t STAT_NONE = 0xff;  // no section or slot, record() ignores it
+
+// 15 bytes on AVR
+struct CommandStat {
+  uint8_t section;  // index passed to record()
+  uint16_t min_us;  // saturates at 65535
+  uint16_t max_us;
+  uint32_t total_us;
+  uint16_t count;
+  uint8_t buckets[STAT_BUCKETS];  // saturate at 255
+};
+
+/*
+ * Every command and named section is a section with one byte in `slot_of`,
+ * so the map follows the command table. Full statistics live in a pool of
+ * STAT_POOL slots, taken by sections in the order they first run after a
+ * reset(). A full command table would need a slot per command, more RAM
+ * than the Uno has left; a query interval rarely runs more than a handful
+ * of commands, and runs of sections that found the pool full are counted
+ * as "untimed".
+ */
+class CommandStats {
+ public:
+  /**
+   * @brief Constructor for the CommandStats class
+   *
+   * @param slot_of Pool slot of each section, one byte per section
+   * @param sections Number of sections slot_of holds
+   */
+  CommandStats(uint8_t* slot_of, uint8_t sections)
+      : slot_of(slot_of), sections(sections), size(0) {
+    reset();
+  }
+
+  /**
+   * @brief Reserves a named section. Named sections come before the table,
+   * at most STAT_NAMED of them.
+   *
+   * @param name Name printed by print(), kept in flash
+   * @return Section index for record(), or STAT_NONE if none is left
+   */
+  uint8_t add(const __FlashStringHelper* name) {
+    if (size >= STAT_NAMED || size >= sections || table_first != STAT_NONE)
+      return STAT_NONE;
+    names[size] = name;
+    return size++;
+  }
+
+  /**
+   * @brief Reserves a table of sections without stored names
+   *
+   * @param count Number of sections
+   * @param namer Prints the name of the section at an offset into the table
+   * @return First section index, or STAT_NONE if they do not all fit
+   */
+  uint8_t add(uint8_t count, void (*namer)(uint8_t index, Stream& interface)) {
+    if (size + count > sections || table_first != STAT_NONE)
+      return STAT_NONE;
+    table_first = size;
+    table_namer = namer;
+    size += count;
+    return table_first;
+  }
+
+  /**
+   * @brief Adds one execution time to a section
+   */
+  void record(unsigned section, unsigned long us) {
+    if (section >= size)
+      return;
+    uint8_t slot = slot_of[section];
+    if (slot == STAT_NONE) {
+      if (used == STAT_POOL) {
+        if (untimed < 0xffff)
+          untimed++;
+        return;
+      }
+      slot = used++;
+      slot_of[section] = slot;
+      pool[slot].section = section;
+    }
+
+    CommandStat& stat = pool[slot];
+    uint16_t clamped = (us > 0xffff) ? 0xffff : us;
+    if (stat.count == 0 || clamped < stat.min_us)
+      stat.min_us = clamped;
+    if (clamped > stat.max_us)
+      stat.max_us = clamped;
+    stat.total_us += us;
+    if (stat.count < 0xffff)
+      stat.count++;
+
+    uint8_t bucket = 0;
+    for (unsigned long v = us >> 6; v > 0 && bucket < STAT_BUCKETS - 1;
+         v >>= 4)
+      bucket++;
+    if (stat.buckets[bucket] < 0xff)
+      stat.buckets[bucket]++;
+  }
+
+  /**
+   * @brief Prints every section that ran as
+   * name,count,min,mean,max,b0,...,b3 (times in us), then untimed,<runs>
+   * if the pool ran out
+   */
+  void print(Stream& interface) {
+    for (uint8_t i = 0; i < used; i++) {
+      CommandStat& stat = pool[i];
+      if (stat.section < table_first)
+        interface.print(names[stat.section]);
+      else
+        table_namer(stat.section - table_first, interface);
+      interface.print(',');
+      interface.print(stat.count);
+      interface.print(',');
+      interface.print(stat.min_us);
+      interface.print(',');
+      interface.print(stat.total_us / stat.count);
+      interface.print(',');
+      interface.print(stat.max_us);
+      for (uint8_t b = 0; b < STAT_BUCKETS; b++) {
+        interface.print(',');
+        interface.print(stat.buckets[b]);
+      }
+      interface.println();
+    }
+    if (untimed) {
+      interface.print(F("untimed,"));
+      interface.println(untimed);
+    }
+  }
+
+  /**
+   * @brief Clears the counts and frees the pool, keeping the sections
+   */
+  void reset() {
+    memset(pool, 0, sizeof(pool));
+    memset(slot_of, STAT_NONE, sections);
+    used = 0;
+    untimed = 0;
+  }
+
+  /**
+   * @brief RAM taken by the statistics, the section map included
+   */
+  int ramSize() { return sizeof(*this) + sections; }
+
+ private:
+  uint8_t* slot_of;
+  uint8_t sections;
+  uint8_t size;
+  const __FlashStringHelper* names[STAT_NAMED];
+  uint8_t table_first = STAT_NONE;
+  void (*table_namer)(uint8_t index, Stream& interface) = NULL;
+  CommandStat pool[STAT_POOL];
+  uint8_t used;      // pool slots taken
+  uint16_t untimed;  // runs that found the pool full
+};
+
+extern CommandStats cmd_stats;
+
+// Times a statement into a section
+#define STAT_TIME(section, statement)                  \
+  do {                                                 \
+    unsigned long stat_start = micros();               \
+    statement;                                         \
+    cmd_stats.record(section, micros() - stat_start);  \
+  } while (0)
+
+#else
+
+#define STAT_TIME(section, statement) statement
+
+#endif
+
+#endif
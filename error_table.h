@@ -21,7 +21,13 @@ enum GenericError {
   TooFewParams = 202,
   UnknownParam = 203,
   ParamOutOfRange = 204,
-  BadSuffix = 205
+  BadSuffix = 205,
+  BadFrame = 206,
+  LinkTimeout = 207,
+  NoSequence = 208,
+  EmptyPreset = 209,
+  LowMemory = 210,
+  TriggerMissed = 211
 };
 
 /*********************************************************/
@@ -34,6 +40,12 @@ const char gen_error_2[] PROGMEM = "Too few Params";
 const char gen_error_3[] PROGMEM = "Unknown Param";
 const char gen_error_4[] PROGMEM = "Out of Range";
 const char gen_error_5[] PROGMEM = "Bad Channel Num";
+const char gen_error_6[] PROGMEM = "Bad Frame";
+const char gen_error_7[] PROGMEM = "Baud Reverted";
+const char gen_error_8[] PROGMEM = "No Sequence";
+const char gen_error_9[] PROGMEM = "Empty Preset";
+const char gen_error_10[] PROGMEM = "Low Memory";
+const char gen_error_11[] PROGMEM = "Trigger Missed";
 
 const char scpi_error_1[] PROGMEM = "Unknown Cmd";
 const char scpi_error_2[] PROGMEM = "Timeout";
@@ -46,9 +58,10 @@ const char ad9106_error_4[] PROGMEM = "Short DOUT";
 const char ad9106_error_5[] PROGMEM = "Short Pat Dly";
 const char ad9106_error_6[] PROGMEM = "Large DOUT";
 
-const char* const gen_error_table[] PROGMEM = {gen_error_0, gen_error_1,
-                                               gen_error_2, gen_error_3,
-                                               gen_error_4, gen_error_5};
+const char* const gen_error_table[] PROGMEM = {
+    gen_error_0, gen_error_1, gen_error_2, gen_error_3, gen_error_4,
+    gen_error_5, gen_error_6, gen_error_7, gen_error_8, gen_error_9,
+    gen_error_10, gen_error_11};
 
 const char* const scpi_error_table[] PROGMEM = {scpi_error_1, scpi_error_2,
                                                 scpi_error_3};
@@ -100,6 +113,24 @@ int get_error_code(GenericError errorCode) {
     case GenericError::BadSuffix:
       code = 5;
       break;
+    case GenericError::BadFrame:
+      code = 6;
+      break;
+    case GenericError::LinkTimeout:
+      code = 7;
+      break;
+    case GenericError::NoSequence:
+      code = 8;
+      break;
+    case GenericError::EmptyPreset:
+      code = 9;
+      break;
+    case GenericError::LowMemory:
+      code = 10;
+      break;
+    case GenericError::TriggerMissed:
+      code = 11;
+      break;
     default:
       return 0;
   }
@@ -133,6 +164,20 @@ int get_error_code(AD9106::ErrorCode errorCode) {
   return 100 * AD9106_PRIORITY + code;
 };
 
+/**
+ * @brief Packs an error code into a byte for the error log
+ *
+ * Priority in the top two bits, index in the rest.
+ */
+uint8_t pack_error(int code) { return (code / 100) << 6 | (code % 100); }
+
+/**
+ * @brief Error code of a byte from pack_error()
+ */
+int unpack_error(uint8_t packed) {
+  return (packed >> 6) * 100 + (packed & 0x3f);
+}
+
 /**
  * @brief Gets the error message pointer from the error code
  */
@@ -1,17 +1,32 @@
 /******************************************************************************
     @file:  global_error.h
 
-    @brief: Global error handling and error buffer
+    @brief: Global error handling and error log
 ******************************************************************************/
 
 #ifndef GLOBAL_ERROR_H
 #define GLOBAL_ERROR_H
 
 #include <avr/pgmspace.h>
+#include "Arduino.h"
 #include "error_table.h"
 
-#define MAX_BUFFER_SIZE 5  // maximum number of errors in buffer
-#define MAX_MSG_SIZE 16    // lcd screen is 16x2
+#define MAX_BUFFER_SIZE 16  // maximum number of entries in the log
+#define MAX_MSG_SIZE 16     // lcd screen is 16x2
+
+// The error handler (LCD to ERROR mode) runs at most this often. Errors in
+// between are logged and shown when the interval is over, see poll().
+const unsigned long ERROR_NOTIFY_MS = 250;
+
+/*
+ * One log entry. A repeat of the newest entry only bumps its count and
+ * time, so an error storm takes one entry instead of flushing the log.
+ */
+struct ErrorEvent {
+  uint8_t code;   // pack_error() of the error code
+  uint8_t count;  // occurrences, saturates at 255
+  uint32_t time;  // millis() of the last occurrence
+};
 
 class GlobalError {
  public:
@@ -38,11 +53,16 @@ class GlobalError {
    */
   bool is_error() { return !(buffer_size == 0); }
 
+  /**
+   * @brief Number of entries in the log (at most MAX_BUFFER_SIZE)
+   */
+  int error_count() { return buffer_size; }
+
   /**
    * @brief Retrieves the last error (most recent) code from the buffer.
    *
    * @param read If true, retrieves but does not remove the last error from the
-   * buffer.
+   * buffer. Removing an entry removes all its repeats.
    * @return The last error code from the buffer.
    */
   int get_error(bool read = false) {
@@ -50,7 +70,7 @@ class GlobalError {
       return 0;
 
     int last_indx = (write_indx - 1 + MAX_BUFFER_SIZE) % MAX_BUFFER_SIZE;
-    int last_error = error_buffer[last_indx];
+    int last_error = unpack_error(error_buffer[last_indx].code);
     if (!read) {
       write_indx = last_indx;
       buffer_size--;
@@ -58,6 +78,35 @@ class GlobalError {
     return last_error;
   }
 
+  /**
+   * @brief Occurrences of the most recent error, 0 if there is none
+   */
+  uint8_t last_count() {
+    if (buffer_size == 0)
+      return 0;
+    return error_buffer[(write_indx - 1 + MAX_BUFFER_SIZE) % MAX_BUFFER_SIZE]
+        .count;
+  }
+
+  /**
+   * @brief Gets an entry, oldest first
+   *
+   * @param index 0 to error_count() - 1
+   */
+  const ErrorEvent& event(int index) {
+    return error_buffer[(write_indx - buffer_size + index + MAX_BUFFER_SIZE) %
+                        MAX_BUFFER_SIZE];
+  }
+
+  /**
+   * @brief Empties the log
+   */
+  void clear() {
+    buffer_size = 0;
+    write_indx = 0;
+    pending = false;
+  }
+
   /**
    * @brief Sets an error in the buffer.
    *
@@ -66,20 +115,60 @@ class GlobalError {
    */
   template <typename ErrorCodeType>
   void set_error(ErrorCodeType errorCode) {
-    int code = get_error_code(errorCode);
+    uint8_t code = pack_error(get_error_code(errorCode));
+    uint32_t now = millis();
+
+    if (buffer_size > 0) {
+      ErrorEvent& last =
+          error_buffer[(write_indx - 1 + MAX_BUFFER_SIZE) % MAX_BUFFER_SIZE];
+      if (last.code == code) {
+        if (last.count < 0xff)
+          last.count++;
+        last.time = now;
+        notify();
+        return;
+      }
+    }
 
-    error_buffer[write_indx] = code;
+    ErrorEvent& entry = error_buffer[write_indx];
+    entry.code = code;
+    entry.count = 1;
+    entry.time = now;
     write_indx = (write_indx + 1) % MAX_BUFFER_SIZE;
     if (buffer_size < MAX_BUFFER_SIZE) {
       buffer_size++;
     }
-    this->ErrorHandler();
+    notify();
+  }
+
+  /**
+   * @brief Runs the error handler held back by the rate limit, unless the
+   * errors were read in the meantime. Call from the main loop.
+   */
+  void poll() {
+    if (pending && buffer_size > 0)
+      notify();
   }
 
  private:
-  int error_buffer[MAX_BUFFER_SIZE];  // circular buffer for errors
-  int buffer_size;                    // size of the error buffer
-  int write_indx;                     // index to write new errors to
+  ErrorEvent error_buffer[MAX_BUFFER_SIZE];  // circular buffer for errors
+  uint8_t buffer_size;                       // entries in the buffer
+  uint8_t write_indx;                        // index to write new errors to
+  bool pending = false;                      // handler held back by the limit
+  bool notified = false;                     // handler ran at least once
+  unsigned long notified_ms;                 // last handler call
+
+  void notify() {
+    unsigned long now = millis();
+    if (notified && now - notified_ms < ERROR_NOTIFY_MS) {
+      pending = true;
+      return;
+    }
+    pending = false;
+    notified = true;
+    notified_ms = now;
+    this->ErrorHandler();
+  }
 };
 
 #endif
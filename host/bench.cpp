@@ -0,0 +1,228 @@
+/******************************************************************************
+    @file:  bench.cpp
+
+    @brief: Replays SCPI scripts against the host build and reports the cost
+            of each command
+
+    Usage: bench [-v] script.scpi ...
+
+    Each non-empty line of a script is sent as one command. Lines starting
+    with '#' are comments, and "!edge" fires the trigger pin interrupt.
+    Lines between "!stream" and "!end" are sent back to back as one row.
+    "!upload <start> <words> [corrupt]" loads a ramp into the pattern SRAM
+    with SOURce:TRACe:LOAD and checks it; "corrupt" damages one chunk.
+    After a command the loop runs until the LCD has caught up, then the handler calls, SPI transactions, SPI words and LCD
+    bytes it caused are printed. -v also prints replies and the screen.
+******************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include "host_sim.h"
+
+void setup();
+void loop();
+
+const unsigned long LOOP_PERIOD_US = 100;  // simulated time per loop()
+const int SETTLE_LOOPS = 64;  // enough for flush() to redraw the whole LCD
+
+/**
+ * @brief Runs loop() until the input is consumed and the LCD has settled
+ */
+static void run_until_idle() {
+  do {
+    loop();
+    host_advance_us(LOOP_PERIOD_US);
+  } while (Serial.available());
+  for (int i = 0; i < SETTLE_LOOPS; i++) {
+    loop();
+    host_advance_us(LOOP_PERIOD_US);
+  }
+}
+
+static uint8_t crc8(const uint8_t* data, size_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+/**
+ * @brief Uploads a ramp with two chunks in flight, as a host should (see
+ * sram_upload.h), and compares the SRAM with it. With `corrupt` one chunk
+ * is damaged, with `edge` the trigger pin fires after the first chunk.
+ *
+ * @return Label for the row, with the outcome
+ */
+static std::string run_upload(const std::string& line) {
+  unsigned start = 0, words = 0;
+  char flag[16] = "";
+  sscanf(line.c_str(), "!upload %u %u %15s", &start, &words, flag);
+  bool corrupt = std::string(flag) == "corrupt";
+  bool edge = std::string(flag) == "edge";
+
+  std::string command = "SOUR:TRAC:LOAD " + std::to_string(start) + "," +
+                        std::to_string(words) + "\n";
+  host_serial_feed(command.data(), command.size());
+  run_until_idle();
+  unsigned chunk_words = 0;
+  if (sscanf(host_serial_take_output().c_str(), "READY %u", &chunk_words) != 1 ||
+      chunk_words == 0)
+    return line + " refused";
+
+  std::vector<uint16_t> wave(words);
+  for (unsigned i = 0; i < words; i++)
+    wave[i] = (uint16_t)(((start + i) * 97) << 4);  // DAC code in [15:4]
+
+  unsigned chunks = (words + chunk_words - 1) / chunk_words;
+  unsigned acked = 0, next = 0, naks = 0;
+  for (int spins = 0; acked < chunks && spins < 100000; spins++) {
+    while (next < chunks && next < acked + 2) {
+      std::vector<uint8_t> frame(1, 0xa5);
+      frame.push_back(next);
+      for (unsigned i = next * chunk_words;
+           i < words && i < (next + 1) * chunk_words; i++) {
+        frame.push_back(wave[i] & 0xff);
+        frame.push_back(wave[i] >> 8);
+      }
+      frame.push_back(crc8(frame.data() + 1, frame.size() - 1));
+      if (corrupt && next == 1) {
+        frame[2] ^= 0xff;
+        corrupt = false;
+      }
+      host_serial_feed((const char*)frame.data(), frame.size());
+      next++;
+    }
+    loop();
+    host_advance_us(LOOP_PERIOD_US);
+    if (edge && acked > 0) {
+      host_fire_interrupt(0);
+      edge = false;
+    }
+    std::string replies = host_serial_take_output();
+    for (size_t i = 0; i + 1 < replies.size(); i += 2) {
+      // Sequence numbers wrap at 256, replies are for chunks from acked on
+      unsigned seq = acked + (uint8_t)(replies[i + 1] - acked);
+      if (replies[i] == 0x06) {
+        acked = seq + 1;
+      } else if (replies[i] == 0x15) {
+        acked = next = seq;
+        naks++;
+      }
+    }
+  }
+  run_until_idle();
+
+  unsigned bad = 0;
+  for (unsigned i = 0; i < words; i++)
+    bad += host_sram(start + i) != wave[i];
+  std::string label = line + (bad ? " MISMATCH" : " ok");
+  if (naks)
+    label += " " + std::to_string(naks) + " nak";
+  return label;
+}
+
+static void print_row(const std::string& label, const HostCounters& c) {
+  printf("%-48s %6lu %6lu %6lu %6lu\n", label.c_str(), c.handler_calls,
+         c.spi_transactions, c.spi_words, c.lcd_bytes);
+}
+
+static void add(HostCounters& total, const HostCounters& c) {
+  total.handler_calls += c.handler_calls;
+  total.spi_transactions += c.spi_transactions;
+  total.spi_words += c.spi_words;
+  total.lcd_bytes += c.lcd_bytes;
+}
+
+/**
+ * @brief Replays one script, returns false if it could not be opened
+ */
+static bool run_script(const char* path, bool verbose, HostCounters& total) {
+  std::ifstream script(path);
+  if (!script) {
+    fprintf(stderr, "bench: cannot open %s\n", path);
+    return false;
+  }
+
+  printf("== %s\n", path);
+  printf("%-48s %6s %6s %6s %6s\n", "command", "calls", "spi_tx", "words",
+         "lcd");
+  std::string line;
+  while (std::getline(script, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    host = HostCounters();
+    if (line.compare(0, 5, "!edge") == 0) {
+      // "!edge <n>": n edges before the loop runs again
+      int edges = 1;
+      sscanf(line.c_str(), "!edge %d", &edges);
+      for (int i = 0; i < edges; i++)
+        host_fire_interrupt(0);
+    } else if (line.compare(0, 7, "!upload") == 0) {
+      line = run_upload(line);
+    } else if (line == "!stream") {
+      std::string block;
+      int count = 0;
+      while (std::getline(script, block) && block.compare(0, 4, "!end") != 0) {
+        if (!block.empty() && block[block.size() - 1] == '\r')
+          block.erase(block.size() - 1);
+        block += "\n";
+        host_serial_feed(block.data(), block.size());
+        count++;
+      }
+      line = "!stream " + std::to_string(count) + " lines";
+    } else {
+      std::string message = line + "\n";
+      host_serial_feed(message.data(), message.size());
+    }
+    run_until_idle();
+
+    HostCounters cost = host;
+    print_row(line, cost);
+    add(total, cost);
+    std::string reply = host_serial_take_output();
+    if (verbose) {
+      if (!reply.empty())
+        printf("  -> %s", reply.c_str());
+      std::string screen = host_screen();
+      size_t split = screen.find('\n');
+      printf("  |%s|\n  |%s|\n", screen.substr(0, split).c_str(),
+             screen.substr(split + 1, split).c_str());
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool verbose = false;
+  int first = 1;
+  if (argc > 1 && std::string(argv[1]) == "-v") {
+    verbose = true;
+    first = 2;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "usage: bench [-v] script.scpi ...\n");
+    return 2;
+  }
+
+  setup();
+  run_until_idle();
+  host_serial_take_output();
+
+  HostCounters total;
+  for (int i = first; i < argc; i++) {
+    if (!run_script(argv[i], verbose, total))
+      return 1;
+  }
+  print_row("== total", total);
+  return 0;
+}
@@ -0,0 +1,249 @@
+/******************************************************************************
+    @file:  host_sim.cpp
+
+    @brief: Simulated clock, Serial, SPI, AD9106 and LCD for the host build
+******************************************************************************/
+
+#include <AD9106.h>
+#include <Adafruit_LiquidCrystal.h>
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "host_sim.h"
+
+/*********************************************************/
+// Clock and pins
+/*********************************************************/
+
+// The clock only moves when the bench or the firmware asks it to, so runs
+// are repeatable
+static unsigned long virtual_us = 0;
+
+void host_advance_us(unsigned long us) { virtual_us += us; }
+unsigned long micros() { return virtual_us; }
+unsigned long millis() { return virtual_us / 1000; }
+void delay(unsigned long ms) { virtual_us += ms * 1000; }
+void delayMicroseconds(unsigned int us) { virtual_us += us; }
+void pinMode(uint8_t, uint8_t) {}
+
+// There is no heap / stack boundary to measure on the host. Report a
+// healthy gap so ram_guard.h never fires, and no stack, heap or globals.
+int free_ram() { return 1024; }
+int stack_high_water() { return 0; }
+int heap_size() { return 0; }
+int static_ram() { return 0; }
+
+/*********************************************************/
+// SPI, decoded as AD9106 streaming transfers
+/*********************************************************/
+
+SPIClass SPI;
+static AD9106* spi_target = NULL;
+static uint8_t spi_target_cs = 0xff;
+static bool spi_selected = false;
+static int spi_word = 0;
+static uint16_t spi_addr = 0;
+static bool spi_read_op = false;
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin != spi_target_cs)
+    return;
+  spi_selected = (val == LOW);
+  if (spi_selected) {
+    host.spi_transactions++;
+    spi_word = 0;
+  }
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+  if (!spi_selected || spi_target == NULL)
+    return 0;
+  host.spi_words++;
+  if (spi_word++ == 0) {
+    spi_read_op = data & 0x8000;
+    spi_addr = data & 0x7fff;
+    return 0;
+  }
+  uint16_t addr = spi_addr--;
+  if (spi_read_op)
+    return (uint16_t)spi_target->peek(addr);
+  spi_target->poke(addr, data);
+  return 0;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) { return 0; }
+int digitalRead(uint8_t) { return LOW; }
+int digitalPinToInterrupt(uint8_t pin) { return pin == 2 ? 0 : pin == 3 ? 1 : -1; }
+static void (*isrs[2])() = {NULL, NULL};
+
+void attachInterrupt(uint8_t irq, void (*isr)(), int) {
+  if (irq < 2)
+    isrs[irq] = isr;
+}
+void detachInterrupt(uint8_t irq) {
+  if (irq < 2)
+    isrs[irq] = NULL;
+}
+void host_fire_interrupt(uint8_t irq) {
+  if (irq < 2 && isrs[irq] != NULL)
+    isrs[irq]();
+}
+void noInterrupts() {}
+void interrupts() {}
+
+/*********************************************************/
+// Serial
+/*********************************************************/
+
+HardwareSerial Serial;
+HostCounters host;
+
+void host_count_handler_call() { host.handler_calls++; }
+
+static std::string rx_data;
+static size_t rx_pos = 0;
+static std::string tx_data;
+
+void host_serial_feed(const char* data, size_t n) { rx_data.append(data, n); }
+std::string host_serial_take_output() {
+  std::string out;
+  out.swap(tx_data);
+  return out;
+}
+
+void HardwareSerial::begin(unsigned long baud) { baud_ = baud; }
+int HardwareSerial::available() { return (int)(rx_data.size() - rx_pos); }
+int HardwareSerial::read() {
+  if (rx_pos >= rx_data.size())
+    return -1;
+  host.serial_rx_bytes++;
+  return (uint8_t)rx_data[rx_pos++];
+}
+int HardwareSerial::peek() {
+  return rx_pos < rx_data.size() ? (uint8_t)rx_data[rx_pos] : -1;
+}
+size_t HardwareSerial::write(uint8_t c) {
+  host.serial_tx_bytes++;
+  tx_data.push_back((char)c);
+  return 1;
+}
+
+/*********************************************************/
+// AD9106
+/*********************************************************/
+
+AD9106::AD9106(int CS) {
+  spi_target = this;
+  spi_target_cs = CS;
+  memset(regs, 0, sizeof(regs));
+  memset(sram, 0, sizeof(sram));
+}
+void AD9106::begin(bool) {}
+void AD9106::spi_init(uint32_t) {}
+void AD9106::reg_reset() {
+  spi_write(SPICONFIG, 0x2004);
+  memset(regs, 0, sizeof(regs));
+  regs[0x20] = 0x0e;
+  regs[PAT_PERIOD] = 0x8000;
+}
+
+void AD9106::spi_write(uint16_t addr, int16_t data) {
+  host.spi_transactions++;
+  host.spi_words += 2;
+  _last_error = NO_ERROR;
+  poke(addr, data);
+}
+
+void AD9106::poke(uint16_t addr, uint16_t data) {
+  if (addr >= SRAM_ADDR && addr < SRAM_ADDR + 4096)
+    sram[addr - SRAM_ADDR] = data;
+  else if (addr < 0x80)
+    regs[addr] = data;
+}
+
+int16_t AD9106::spi_read(uint16_t addr) {
+  host.spi_transactions++;
+  host.spi_words += 2;
+  return peek(addr);
+}
+
+int16_t AD9106::peek(uint16_t addr) {
+  if (addr >= SRAM_ADDR && addr < SRAM_ADDR + 4096)
+    return (int16_t)sram[addr - SRAM_ADDR];
+  return addr < 0x80 ? (int16_t)regs[addr] : 0;
+}
+
+void AD9106::update_pattern() {
+  spi_write(RAMUPDATE, 1);
+  if (regs[0x20] < 0x0e)
+    _last_error = PAT_DLY_SHORT_ERR;
+  running = true;
+}
+void AD9106::start_pattern() {
+  spi_write(PAT_STATUS, 1);
+  running = true;
+}
+void AD9106::stop_pattern() {
+  spi_write(PAT_STATUS, 0);
+  running = false;
+}
+void AD9106::setDDSsine(CHNL chan) {
+  uint16_t shift = (chan % 2) ? 0 : 8;
+  uint16_t addr = (chan > 2) ? WAV4_3CONFIG : WAV2_1CONFIG;
+  spi_write(addr, (regs[addr] & ~(0xff << shift)) | (0x31 << shift));
+}
+void AD9106::setDDSfreq(float freq) {
+  uint32_t tw = (uint32_t)(freq * 16777216.0 / fclk + 0.5);
+  spi_write(DDS_TW32, (int16_t)(tw >> 8));
+  spi_write(DDS_TW1, (int16_t)((tw & 0xff) << 8));
+}
+float AD9106::getDDSfreq() {
+  uint32_t tw = ((uint32_t)(uint16_t)spi_read(DDS_TW32) << 8) |
+                ((uint16_t)spi_read(DDS_TW1) >> 8);
+  return tw * fclk / 16777216.0;
+}
+void AD9106::set_CHNL_DGAIN(CHNL chan, int16_t gain) {
+  spi_write(DAC1_DGAIN + 1 - chan, gain);
+}
+void AD9106::set_CHNL_prop(CHNL_PROP prop, CHNL chan, int16_t val) {
+  if (prop == DDS_PHASE)
+    spi_write(DDS1_PW + 1 - chan, val);
+}
+int16_t AD9106::get_CHNL_prop(CHNL_PROP prop, CHNL chan) {
+  return prop == DDS_PHASE ? spi_read(DDS1_PW + 1 - chan) : 0;
+}
+
+uint16_t host_sram(uint16_t addr) {
+  return spi_target != NULL ? spi_target->sram[addr % 4096] : 0;
+}
+
+/*********************************************************/
+// LCD
+/*********************************************************/
+
+void Adafruit_LiquidCrystal::begin(uint8_t, uint8_t) { clear(); }
+void Adafruit_LiquidCrystal::clear() {
+  host.lcd_bytes++;
+  memset(screen, ' ', sizeof(screen));
+  col = row = 0;
+}
+void Adafruit_LiquidCrystal::home() {
+  host.lcd_bytes++;
+  col = row = 0;
+}
+void Adafruit_LiquidCrystal::setCursor(uint8_t c, uint8_t r) {
+  host.lcd_bytes++;
+  col = c;
+  row = r % 2;
+}
+void Adafruit_LiquidCrystal::createChar(uint8_t, uint8_t*) {
+  host.lcd_bytes += 9;
+}
+size_t Adafruit_LiquidCrystal::write(uint8_t c) {
+  host.lcd_bytes++;
+  if (col < 16)
+    screen[row][col] = (char)(c < 8 ? '#' : c);
+  col++;
+  return 1;
+}
+
@@ -0,0 +1,56 @@
+/******************************************************************************
+    @file:  host_sim.h
+
+    @brief: Counters and serial plumbing shared by the host stand-ins
+******************************************************************************/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Traffic the firmware generates, reset by the bench between commands
+struct HostCounters {
+  unsigned long handler_calls = 0;
+  unsigned long spi_transactions = 0;  // CS assertions, reads included
+  unsigned long spi_words = 0;         // 16 bit words, instruction included
+  unsigned long lcd_bytes = 0;         // bytes sent to the LCD controller
+  unsigned long serial_rx_bytes = 0;
+  unsigned long serial_tx_bytes = 0;
+};
+
+extern HostCounters host;
+
+/**
+ * @brief Queues bytes for the firmware to read from Serial
+ */
+void host_serial_feed(const char* data, size_t n);
+
+/**
+ * @brief Returns and clears everything the firmware wrote to Serial
+ */
+std::string host_serial_take_output();
+
+/**
+ * @brief Runs the ISR attached to an external interrupt (0 = pin 2)
+ */
+void host_fire_interrupt(uint8_t irq);
+
+/**
+ * @brief Advances the simulated clock
+ */
+void host_advance_us(unsigned long us);
+
+/**
+ * @brief Contents of the simulated LCD, one line per row
+ */
+std::string host_screen();
+
+/**
+ * @brief Word of the simulated AD9106 pattern SRAM
+ */
+uint16_t host_sram(uint16_t addr);
+
+#endif
@@ -0,0 +1,24 @@
+/******************************************************************************
+    @file:  sketch.cpp
+
+    @brief: Compiles ACDAC_box_driver.ino as an ordinary translation unit
+******************************************************************************/
+
+#include <string>
+
+// The Arduino builder generates prototypes for functions in a .ino file
+#include "Arduino.h"
+void GlobalErrorHandler();
+void printCommandName(uint8_t index, Stream& interface);
+void inputTask();
+void sequencerTask();
+void displayTask();
+void housekeepingTask();
+void linkTask();
+
+#include "../ACDAC_box_driver.ino"
+
+std::string host_screen() {
+  return std::string(view.lcd.screen[0], LCD_COLS) + "\n" +
+         std::string(view.lcd.screen[1], LCD_COLS) + "\n";
+}
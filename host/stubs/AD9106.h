@@ -0,0 +1,73 @@
+/******************************************************************************
+    @file:  AD9106.h
+
+    @brief: Host stand-in for the AD9106 library with a simulated register file and SRAM
+******************************************************************************/
+
+#ifndef AD9106_H
+#define AD9106_H
+
+#include "Arduino.h"
+
+enum CHNL { CHNL_1 = 1, CHNL_2 = 2, CHNL_3 = 3, CHNL_4 = 4 };
+enum CHNL_PROP { DDS_PHASE, DIG_GAIN, DIG_OFFSET, START_DELAY };
+
+class AD9106 {
+ public:
+  enum ErrorCode {
+    NO_ERROR = 0,
+    MEM_READ_ERR,
+    ODD_ADDR_ERR,
+    PERIOD_SHORT_ERR,
+    DOUT_START_SHORT_ERR,
+    PAT_DLY_SHORT_ERR,
+    DOUT_START_LG_ERR
+  };
+
+  static const uint16_t SPICONFIG = 0x00;
+  static const uint16_t RAMUPDATE = 0x1d;
+  static const uint16_t PAT_STATUS = 0x1e;
+  static const uint16_t PAT_TYPE = 0x1f;
+  static const uint16_t WAV4_3CONFIG = 0x26;
+  static const uint16_t WAV2_1CONFIG = 0x27;
+  static const uint16_t PAT_PERIOD = 0x29;
+  static const uint16_t DAC4_DGAIN = 0x32;
+  static const uint16_t DAC1_DGAIN = 0x35;
+  static const uint16_t DDS_TW32 = 0x3e;
+  static const uint16_t DDS_TW1 = 0x3f;
+  static const uint16_t DDS4_PW = 0x40;
+  static const uint16_t DDS1_PW = 0x43;
+  static const uint16_t START_ADDR4 = 0x51;
+  static const uint16_t CFG_ERROR = 0x60;
+  static const uint16_t SRAM_ADDR = 0x6000;
+
+  ErrorCode _last_error = NO_ERROR;
+  float fclk = 180000000;
+
+  AD9106(int CS);
+  void begin(bool op_amps);
+  void spi_init(uint32_t clk);
+  void reg_reset();
+  void update_pattern();
+  void start_pattern();
+  void stop_pattern();
+  void setDDSsine(CHNL chan);
+  void setDDSfreq(float freq);
+  float getDDSfreq();
+  void set_CHNL_DGAIN(CHNL chan, int16_t gain);
+  void set_CHNL_prop(CHNL_PROP prop, CHNL chan, int16_t val);
+  int16_t get_CHNL_prop(CHNL_PROP prop, CHNL chan);
+  void spi_write(uint16_t addr, int16_t data);
+  int16_t spi_read(uint16_t addr);
+
+  // Host simulation bookkeeping
+  void poke(uint16_t addr, uint16_t data);
+  int16_t peek(uint16_t addr);
+  uint16_t regs[0x80];
+  uint16_t sram[4096];
+  unsigned long spi_transactions = 0;
+  unsigned long spi_words = 0;
+  bool running = false;
+};
+
+#endif
@@ -0,0 +1,29 @@
+/******************************************************************************
+    @file:  Adafruit_LiquidCrystal.h
+
+    @brief: Host stand-in for the LCD backpack that keeps a copy of the screen
+******************************************************************************/
+
+#ifndef ADAFRUIT_LIQUIDCRYSTAL_H
+#define ADAFRUIT_LIQUIDCRYSTAL_H
+
+#include "Arduino.h"
+
+class Adafruit_LiquidCrystal : public Print {
+ public:
+  Adafruit_LiquidCrystal(uint8_t data, uint8_t clock, uint8_t latch) {}
+  void begin(uint8_t cols, uint8_t rows);
+  void clear();
+  void home();
+  void setCursor(uint8_t col, uint8_t row);
+  void createChar(uint8_t location, uint8_t charmap[]);
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Host simulation bookkeeping
+  char screen[2][16];
+  uint8_t col = 0, row = 0;
+  unsigned long bytes_sent = 0;
+};
+
+#endif
@@ -0,0 +1,147 @@
+/******************************************************************************
+    @file:  Arduino.h
+
+    @brief: Host stand-in for the Arduino core: types, timing, pins, Print/Stream and Serial
+******************************************************************************/
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode);
+void detachInterrupt(uint8_t irq);
+void noInterrupts();
+void interrupts();
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    size_t i = 0;
+    while (i < n && write(buf[i]))
+      i++;
+    return i;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  virtual void flush() {}
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const __FlashStringHelper* s) { return print((const char*)s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC) {
+    if (base == DEC) {
+      char buf[24];
+      snprintf(buf, sizeof(buf), "%ld", n);
+      return print(buf);
+    }
+    return print((unsigned long)n, base);
+  }
+  size_t print(unsigned long n, int base = DEC) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", n);
+    return print(buf);
+  }
+  size_t print(double n, int digits = 2) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+  }
+  size_t println() { return print("\r\n"); }
+  template <typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(T v, int fmt) {
+    size_t n = print(v, fmt);
+    return n + println();
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(char* buf, size_t n) {
+    size_t i = 0;
+    while (i < n && available())
+      buf[i++] = (char)read();
+    return i;
+  }
+};
+
+class String {
+ public:
+  String(const char* s = "") { buf_ = strdup(s ? s : ""); }
+  String(const String& o) { buf_ = strdup(o.buf_); }
+  String& operator=(const String& o) {
+    if (this != &o) {
+      free(buf_);
+      buf_ = strdup(o.buf_);
+    }
+    return *this;
+  }
+  ~String() { free(buf_); }
+  const char* c_str() const { return buf_; }
+  unsigned int length() const { return strlen(buf_); }
+
+ private:
+  char* buf_;
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud);
+  void end() {}
+  operator bool() { return true; }
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  using Print::write;
+  unsigned long baud() const { return baud_; }
+
+ private:
+  unsigned long baud_ = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
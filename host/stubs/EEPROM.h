@@ -0,0 +1,36 @@
+/******************************************************************************
+    @file:  EEPROM.h
+
+    @brief: Host stand-in for the EEPROM library backed by RAM
+******************************************************************************/
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+ public:
+  EEPROMClass() { memset(data_, 0xff, sizeof(data_)); }
+  uint8_t read(int idx) { return data_[idx]; }
+  void write(int idx, uint8_t val) { data_[idx] = val; }
+  void update(int idx, uint8_t val) { data_[idx] = val; }
+  uint16_t length() { return sizeof(data_); }
+  template <typename T>
+  T& get(int idx, T& t) {
+    memcpy(&t, data_ + idx, sizeof(T));
+    return t;
+  }
+  template <typename T>
+  const T& put(int idx, const T& t) {
+    memcpy(data_ + idx, &t, sizeof(T));
+    return t;
+  }
+
+ private:
+  uint8_t data_[1024];
+};
+
+static EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,33 @@
+/******************************************************************************
+    @file:  SPI.h
+
+    @brief: Host stand-in for the SPI library. Transfers are decoded as AD9106 streaming frames
+******************************************************************************/
+
+#ifndef SPI_H
+#define SPI_H
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+
+class SPISettings {
+ public:
+  SPISettings() {}
+  SPISettings(uint32_t clock, uint8_t bit_order, uint8_t data_mode) {}
+};
+
+class SPIClass {
+ public:
+  void begin() {}
+  void beginTransaction(SPISettings settings) {}
+  void endTransaction() {}
+  void usingInterrupt(uint8_t interruptNumber) {}
+  uint8_t transfer(uint8_t data);
+  uint16_t transfer16(uint16_t data);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,207 @@
+/******************************************************************************
+    @file:  Vrekrer_scpi_parser.h
+
+    @brief: Host stand-in for Vrekrer_scpi_parser, a subset of its matching rules
+******************************************************************************/
+
+#ifndef VREKRER_SCPI_PARSER_H_
+#define VREKRER_SCPI_PARSER_H_
+
+#include <ctype.h>
+#include "Arduino.h"
+
+void host_count_handler_call();
+
+#ifndef SCPI_ARRAY_SYZE
+#define SCPI_ARRAY_SYZE 6
+#endif
+#ifndef SCPI_MAX_COMMANDS
+#define SCPI_MAX_COMMANDS 20
+#endif
+#ifndef SCPI_BUFFER_LENGTH
+#define SCPI_BUFFER_LENGTH 64
+#endif
+
+class SCPI_String_Array {
+ public:
+  char* operator[](const uint8_t index) const { return values_[index]; }
+  void Append(char* value) {
+    if (size_ < SCPI_ARRAY_SYZE)
+      values_[size_++] = value;
+  }
+  char* Pop() { return size_ ? values_[--size_] : NULL; }
+  char* First() const { return size_ ? values_[0] : NULL; }
+  char* Last() const { return size_ ? values_[size_ - 1] : NULL; }
+  uint8_t Size() const { return size_; }
+
+ protected:
+  uint8_t size_ = 0;
+  char* values_[SCPI_ARRAY_SYZE];
+};
+
+class SCPI_Commands : public SCPI_String_Array {
+ public:
+  char* not_processed_message = NULL;
+};
+
+class SCPI_Parameters : public SCPI_String_Array {
+ public:
+  char* not_processed_message = NULL;
+};
+
+typedef SCPI_Commands SCPI_C;
+typedef SCPI_Parameters SCPI_P;
+typedef void (*SCPI_caller_t)(SCPI_C, SCPI_P, Stream&);
+
+class SCPI_Parser {
+ public:
+  enum class ErrorCode { NoError, UnknownCommand, Timeout, BufferOverflow };
+  ErrorCode last_error = ErrorCode::NoError;
+  void SetCommandTreeBase(const char* tree_base);
+  void SetCommandTreeBase(const __FlashStringHelper* tree_base);
+  void RegisterCommand(const char* command, SCPI_caller_t caller);
+  void RegisterCommand(const __FlashStringHelper* command, SCPI_caller_t caller);
+  void SetErrorHandler(SCPI_caller_t caller);
+  void Execute(char* message, Stream& interface);
+  char* GetMessage(Stream& interface, const char* term_chars);
+  void ProcessInput(Stream& interface, const char* term_chars);
+
+ private:
+  bool Matches(const char* pattern, SCPI_C& commands);
+  char tree_base_[24] = "";
+  char patterns_[SCPI_MAX_COMMANDS][64];
+  SCPI_caller_t callers_[SCPI_MAX_COMMANDS];
+  uint8_t codes_size_ = 0;
+  SCPI_caller_t error_handler_ = NULL;
+  char msg_buffer_[SCPI_BUFFER_LENGTH];
+  uint8_t message_length_ = 0;
+};
+
+/*********************************************************/
+// SCPI parser (subset of Vrekrer_scpi_parser semantics)
+/*********************************************************/
+
+inline void SCPI_Parser::SetCommandTreeBase(const char* tree_base) {
+  snprintf(tree_base_, sizeof(tree_base_), "%s", tree_base);
+}
+inline void SCPI_Parser::SetCommandTreeBase(const __FlashStringHelper* tree_base) {
+  SetCommandTreeBase((const char*)tree_base);
+}
+inline void SCPI_Parser::RegisterCommand(const char* command, SCPI_caller_t caller) {
+  if (codes_size_ >= SCPI_MAX_COMMANDS) {
+    fprintf(stderr, "host: SCPI_MAX_COMMANDS exceeded by %s\n", command);
+    return;
+  }
+  const char* sep = (tree_base_[0] && command[0] != ':') ? ":" : "";
+  snprintf(patterns_[codes_size_], sizeof(patterns_[0]), "%s%s%s", tree_base_,
+           sep, command);
+  callers_[codes_size_++] = caller;
+}
+inline void SCPI_Parser::RegisterCommand(const __FlashStringHelper* command,
+                                  SCPI_caller_t caller) {
+  RegisterCommand((const char*)command, caller);
+}
+inline void SCPI_Parser::SetErrorHandler(SCPI_caller_t caller) {
+  error_handler_ = caller;
+}
+
+// Compare one header token against one pattern token ("CHANnel#", "VOLTage?")
+inline bool scpi_token_matches(const char* pat, size_t pat_len, const char* tok) {
+  bool pat_query = pat_len && pat[pat_len - 1] == '?';
+  if (pat_query)
+    pat_len--;
+  bool pat_suffix = pat_len && pat[pat_len - 1] == '#';
+  if (pat_suffix)
+    pat_len--;
+
+  size_t tok_len = strlen(tok);
+  bool tok_query = tok_len && tok[tok_len - 1] == '?';
+  if (tok_query)
+    tok_len--;
+  if (pat_query != tok_query)
+    return false;
+  if (pat_suffix)
+    while (tok_len && isdigit((unsigned char)tok[tok_len - 1]))
+      tok_len--;
+
+  size_t short_len = 0;
+  while (short_len < pat_len && !islower((unsigned char)pat[short_len]))
+    short_len++;
+  if (tok_len != short_len && tok_len != pat_len)
+    return false;
+  for (size_t i = 0; i < tok_len; i++)
+    if (toupper((unsigned char)pat[i]) != toupper((unsigned char)tok[i]))
+      return false;
+  return true;
+}
+
+inline bool SCPI_Parser::Matches(const char* pattern, SCPI_C& commands) {
+  uint8_t index = 0;
+  while (*pattern) {
+    if (*pattern == ':')
+      pattern++;
+    size_t len = strcspn(pattern, ":");
+    if (index >= commands.Size() ||
+        !scpi_token_matches(pattern, len, commands[index]))
+      return false;
+    index++;
+    pattern += len;
+  }
+  return index == commands.Size();
+}
+
+inline void SCPI_Parser::Execute(char* message, Stream& interface) {
+  SCPI_C commands;
+  SCPI_P parameters;
+  char* params = strpbrk(message, " \t");
+  if (params)
+    *params++ = '\0';
+  for (char* tok = strtok(message, ":"); tok; tok = strtok(NULL, ":"))
+    commands.Append(tok);
+  if (params)
+    for (char* tok = strtok(params, ", \t"); tok; tok = strtok(NULL, ", \t"))
+      parameters.Append(tok);
+
+  for (uint8_t i = 0; i < codes_size_; i++) {
+    if (Matches(patterns_[i], commands)) {
+      host_count_handler_call();
+      callers_[i](commands, parameters, interface);
+      return;
+    }
+  }
+  last_error = ErrorCode::UnknownCommand;
+  if (error_handler_)
+    error_handler_(commands, parameters, interface);
+}
+
+inline char* SCPI_Parser::GetMessage(Stream& interface, const char* term_chars) {
+  while (interface.available()) {
+    char c = (char)interface.read();
+    if (strchr(term_chars, c)) {
+      msg_buffer_[message_length_] = '\0';
+      message_length_ = 0;
+      return msg_buffer_;
+    }
+    if (c == '\r')
+      continue;
+    if (message_length_ >= SCPI_BUFFER_LENGTH - 1) {
+      message_length_ = 0;
+      last_error = ErrorCode::BufferOverflow;
+      SCPI_C commands;
+      SCPI_P parameters;
+      if (error_handler_)
+        error_handler_(commands, parameters, interface);
+      return NULL;
+    }
+    msg_buffer_[message_length_++] = c;
+  }
+  return NULL;
+}
+
+inline void SCPI_Parser::ProcessInput(Stream& interface, const char* term_chars) {
+  char* message = GetMessage(interface, term_chars);
+  if (message != NULL)
+    Execute(message, interface);
+}
+
+#endif
@@ -0,0 +1,9 @@
+/******************************************************************************
+    @file:  Wire.h
+
+    @brief: Host stand-in for Wire, unused by the simulation
+******************************************************************************/
+
+#ifndef WIRE_H
+#define WIRE_H
+#endif
@@ -0,0 +1,59 @@
+/******************************************************************************
+    @file:  pgmspace.h
+
+    @brief: Host stand-in for avr/pgmspace.h. Program memory is ordinary memory
+******************************************************************************/
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+// Reads go through memcpy so that, as on the AVR, any object can be read
+// back as bytes or words
+inline uint8_t host_pgm_read_byte(const void* addr) {
+  uint8_t val;
+  memcpy(&val, addr, sizeof(val));
+  return val;
+}
+inline uint16_t host_pgm_read_word(const void* addr) {
+  uint16_t val;
+  memcpy(&val, addr, sizeof(val));
+  return val;
+}
+inline uint32_t host_pgm_read_dword(const void* addr) {
+  uint32_t val;
+  memcpy(&val, addr, sizeof(val));
+  return val;
+}
+inline float host_pgm_read_float(const void* addr) {
+  float val;
+  memcpy(&val, addr, sizeof(val));
+  return val;
+}
+inline void* host_pgm_read_ptr(const void* addr) {
+  void* val;
+  memcpy(&val, addr, sizeof(val));
+  return val;
+}
+
+#define pgm_read_byte(addr) host_pgm_read_byte(addr)
+#define pgm_read_byte_near(addr) host_pgm_read_byte(addr)
+#define pgm_read_word(addr) host_pgm_read_word(addr)
+#define pgm_read_word_near(addr) host_pgm_read_word(addr)
+#define pgm_read_dword(addr) host_pgm_read_dword(addr)
+#define pgm_read_dword_near(addr) host_pgm_read_dword(addr)
+#define pgm_read_float(addr) host_pgm_read_float(addr)
+#define pgm_read_float_near(addr) host_pgm_read_float(addr)
+#define pgm_read_ptr(addr) host_pgm_read_ptr(addr)
+#define pgm_read_ptr_near(addr) host_pgm_read_ptr(addr)
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#endif
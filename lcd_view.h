@@ -18,6 +18,45 @@
 
 extern GlobalError system_error;
 
+const uint8_t LCD_COLS = 16;
+const uint8_t LCD_ROWS = 2;
+const uint8_t LCD_CELLS = LCD_COLS * LCD_ROWS;
+const uint8_t LCD_BYTES_PER_TICK = 4;  // LCD transfers allowed per flush()
+
+/**
+ * @brief Off-screen copy of the display that the view draws into
+ */
+class LCDFrame : public Print {
+ public:
+  char cells[LCD_ROWS][LCD_COLS];
+
+  LCDFrame() { clear(); }
+
+  void clear() {
+    memset(cells, ' ', sizeof(cells));
+    col = 0;
+    row = 0;
+  }
+
+  void setCursor(uint8_t c, uint8_t r) {
+    col = c;
+    row = r;
+  }
+
+  // Text past the end of a row is clipped, as it is off screen on the LCD
+  size_t write(uint8_t c) {
+    if (row < LCD_ROWS && col < LCD_COLS)
+      cells[row][col] = c;
+    col++;
+    return 1;
+  }
+  using Print::write;
+
+ private:
+  uint8_t col;
+  uint8_t row;
+};
+
 class LCDView {
  public:
   Adafruit_LiquidCrystal lcd;
@@ -38,8 +77,10 @@ class LCDView {
    * @brief Initializes the LCD display
    */
   void begin() {
-    lcd.begin(16, 2);
+    lcd.begin(LCD_COLS, LCD_ROWS);
     lcd.createChar(0, graphene_icon);
+    memset(shown, ' ', sizeof(shown));
+    cursor = 0xff;
     this->reset();
   }
 
@@ -47,17 +88,21 @@ class LCDView {
    * @brief Resets the LCD display
    */
   void reset() {
-    lcd.clear();
-    lcd.home();
-    lcd.print(F("Barrera2D"));
-    lcd.write(byte(0));
-    lcd.print(F("Lab"));
-    lcd.setCursor(0, 1);
-    lcd.print(F("ACDAC 02 AD9106"));
+    frame.clear();
+    frame.setCursor(0, 0);
+    frame.print(F("Barrera2D"));
+    frame.write(byte(0));
+    frame.print(F("Lab"));
+    frame.setCursor(0, 1);
+    frame.print(F("ACDAC 02 AD9106"));
+    pending = true;
+    clean = 0;
   }
 
   /**
-   * @brief Updates the LCD display depending on view state
+   * @brief Redraws the frame depending on view state
+   *
+   * Only touches RAM. The LCD catches up through flush().
    */
   void update() {
     if (state->mode == ViewState::Mode::ERROR) {
@@ -68,10 +113,50 @@ class LCDView {
       (state->mode == ViewState::Mode::NORMAL) ? display_normal()
                                                : display_focus();
     state->update = false;
+    pending = true;
+    clean = 0;
+  }
+
+  /**
+   * @brief Sends up to LCD_BYTES_PER_TICK changed cells to the LCD
+   *
+   * Called every loop. Cells are compared against a copy of what the LCD
+   * shows, so only differences are sent, and the cursor is only moved when
+   * the next changed cell is not where the LCD's auto-increment left it.
+   */
+  void flush() {
+    uint8_t budget = LCD_BYTES_PER_TICK;
+    while (pending && budget > 0) {
+      uint8_t r = scan / LCD_COLS;
+      uint8_t c = scan % LCD_COLS;
+      if (frame.cells[r][c] != shown[r][c]) {
+        if (cursor != scan) {
+          if (budget < 2)
+            return;
+          lcd.setCursor(c, r);
+          budget--;
+        }
+        lcd.write(frame.cells[r][c]);
+        budget--;
+        shown[r][c] = frame.cells[r][c];
+        cursor = (c == LCD_COLS - 1) ? 0xff : scan + 1;
+        clean = 0;
+      } else if (++clean == LCD_CELLS) {
+        pending = false;
+        clean = 0;
+      }
+      scan = (scan + 1) % LCD_CELLS;
+    }
   }
 
  private:
   ViewState* state;
+  LCDFrame frame;
+  char shown[LCD_ROWS][LCD_COLS];  // what the LCD currently displays
+  uint8_t cursor;                  // LCD cursor as a cell index, 0xff unknown
+  uint8_t scan = 0;                // next cell flush() compares
+  uint8_t clean = 0;               // consecutive unchanged cells seen
+  bool pending = false;            // frame may differ from the LCD
 
   // Graphene Icon bitmap
   byte graphene_icon[8] = {0b00010, 0b00101, 0b00101, 0b01010,
@@ -81,15 +166,15 @@ class LCDView {
    * @brief Displays voltage and phase for all channels
    */
   void display_normal() {
-    lcd.clear();
+    frame.clear();
     for (int i = 0; i < 4; i++) {
       int volt = state->getVolts(i + 1);
       int phase = (int)state->getPhase(i + 1);
 
-      lcd.setCursor((8 * i) % 16, (int)i / 2);
-      lcd.print(volt);
-      lcd.print(F(":"));
-      lcd.print(phase);
+      frame.setCursor((8 * i) % 16, (int)i / 2);
+      frame.print(volt);
+      frame.print(F(":"));
+      frame.print(phase);
     }
   }
 
@@ -97,7 +182,7 @@ class LCDView {
    * @brief Displays channel specific data
    */
   void display_focus() {
-    lcd.clear();
+    frame.clear();
     int chan = 0;
     switch (state->mode) {
       case ViewState::Mode::FOCUS1:
@@ -117,20 +202,20 @@ class LCDView {
     float voltage = state->getVolts(chan);
     float phase = state->getPhase(chan);
 
-    lcd.setCursor(0, 0);
-    lcd.print(F("CH"));
-    lcd.print(chan);
+    frame.setCursor(0, 0);
+    frame.print(F("CH"));
+    frame.print(chan);
 
-    lcd.setCursor(4, 0);
-    lcd.print(state->freq);
-    lcd.print(F("Hz"));
+    frame.setCursor(4, 0);
+    frame.print(state->freq);
+    frame.print(F("Hz"));
 
-    lcd.setCursor(0, 1);
-    lcd.print(voltage, 1);
-    lcd.print(F("mV"));
+    frame.setCursor(0, 1);
+    frame.print(voltage, 1);
+    frame.print(F("mV"));
 
-    lcd.setCursor(8, 1);
-    lcd.print(phase);
+    frame.setCursor(8, 1);
+    frame.print(phase);
   }
 
   /**
@@ -140,22 +225,27 @@ class LCDView {
     int code = system_error.get_error(true);
     const char* msg = get_error_ptr(code);
     strcpy_P(system_error.message_buffer, msg);
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print(F("Error "));
-    lcd.print(code);
-    lcd.setCursor(0, 1);
-    lcd.print(system_error.message_buffer);
+    frame.clear();
+    frame.setCursor(0, 0);
+    frame.print(F("Error "));
+    frame.print(code);
+    uint8_t count = system_error.last_count();
+    if (count > 1) {
+      frame.print(F(" x"));
+      frame.print(count);
+    }
+    frame.setCursor(0, 1);
+    frame.print(system_error.message_buffer);
   }
 
   /**
    * @brief Disables updates for remote mode
    */
   void display_remote() {
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.write(byte(0));
-    lcd.print(F("Remote Access"));
+    frame.clear();
+    frame.setCursor(0, 0);
+    frame.write(byte(0));
+    frame.print(F("Remote Access"));
   }
 };
 
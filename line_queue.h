@@ -0,0 +1,188 @@
+/******************************************************************************
+    @file:  line_queue.h
+
+    @brief: Assembles serial input into complete lines and queues them for
+            dispatch
+******************************************************************************/
+
+#ifndef LINE_QUEUE_H
+#define LINE_QUEUE_H
+
+#include <Vrekrer_scpi_parser.h>
+#include "Arduino.h"
+#include "global_error.h"
+
+extern GlobalError system_error;
+
+const uint8_t LINE_QUEUE_SIZE = 192;  // bytes of queued and partial lines
+const uint8_t LINE_MAX = 95;          // longest line, terminator excluded
+
+static_assert(LINE_QUEUE_SIZE >= 2 * (LINE_MAX + 1),
+              "LINE_QUEUE_SIZE must hold a queued and a partial line");
+
+/*
+ * Ring buffer of '\0' terminated lines. Every line is kept contiguous so it
+ * can be dispatched in place: a partial line that reaches the end of the
+ * buffer moves to the front, and `fence` marks where the older lines stop.
+ *
+ *   [line 2][partial]....[line 0][line 1]|fence
+ *                        ^head
+ *
+ * On the Uno pump() runs from the Timer0 compare A and B interrupts, twice
+ * per ms, so input is taken off the 64 byte hardware buffer while a handler
+ * or an EEPROM write keeps the loop busy. Each run empties the hardware
+ * buffer, which holds the 51 bytes arriving in half a ms at 1000000 baud.
+ * The run enables interrupts again, as the USART receive interrupt has to
+ * keep up with it. When the queue is full pump() leaves the bytes in the
+ * hardware buffer. A line longer than LINE_MAX raises a Buffer Ovf error
+ * and is dropped up to its newline, without blocking.
+ */
+class LineQueue {
+ public:
+  /**
+   * @brief Starts taking input from the timer interrupts
+   */
+  void begin() {
+#ifdef __AVR__
+    // Timer0 runs millis(), each compare fires once per overflow. Pins 5 and
+    // 6 drive the LCD, so the compare registers are not used for PWM.
+    OCR0A = 0x00;
+    OCR0B = 0x80;
+    TIMSK0 |= _BV(OCIE0A) | _BV(OCIE0B);
+#endif
+  }
+
+  /**
+   * @brief Reports overflows, and reads input on builds without the timer
+   * interrupt. Call from the main loop.
+   */
+  void poll(Stream& interface) {
+#ifndef __AVR__
+    pump(interface);
+#endif
+    if (overflowed) {
+      overflowed = false;
+      system_error.set_error(SCPI_Parser::ErrorCode::BufferOverflow);
+    }
+  }
+
+  /**
+   * @brief Stops or resumes taking input, e.g. for binary frames
+   */
+  void pause(bool paused) { this->paused = paused; }
+
+  /**
+   * @brief Moves available input into the queue, until there is none or the
+   * queue is full
+   */
+  void pump(Stream& interface) {
+    while (!paused) {
+      int c = interface.peek();
+      if (c < 0)
+        return;
+      if (discarding) {
+        discarding = (c != '\n');
+      } else if (c == '\n') {
+        if (!reserve())
+          return;
+        buffer[tail + len] = '\0';
+        tail += len + 1;
+        len = 0;
+        lines++;
+      } else if (c == '\r') {
+        // dropped, lines may end in "\r\n"
+      } else if (len == LINE_MAX) {
+        len = 0;
+        discarding = true;
+        overflowed = true;
+      } else {
+        if (!reserve())
+          return;
+        buffer[tail + len++] = c;
+      }
+      interface.read();
+    }
+  }
+
+  /**
+   * @brief Oldest complete line, NULL if there is none
+   *
+   * The line may be modified in place. It stays valid until pop().
+   */
+  char* front() {
+    if (lines == 0)
+      return NULL;
+    return buffer + head;
+  }
+
+  /**
+   * @brief Removes the line front() returned
+   *
+   * @param length Its length before it was modified
+   */
+  void pop(uint8_t length) {
+    noInterrupts();
+    head += length + 1;
+    if (head == fence) {
+      head = 0;
+      fence = LINE_QUEUE_SIZE;
+    }
+    lines--;
+    interrupts();
+  }
+
+ private:
+  char buffer[LINE_QUEUE_SIZE];
+  volatile uint8_t head = 0;  // first byte of the oldest line
+  volatile uint8_t tail = 0;  // first byte of the partial line
+  volatile uint8_t len = 0;   // bytes in the partial line
+  volatile uint8_t fence = LINE_QUEUE_SIZE;  // end of the lines before front
+  volatile uint8_t lines = 0;                // complete lines queued
+  volatile bool discarding = false;  // dropping an overlong line
+  volatile bool overflowed = false;  // error not reported yet
+  volatile bool paused = false;
+
+  /**
+   * @brief Makes room for one more byte of the partial line
+   *
+   * @return false if the queue is full
+   */
+  bool reserve() {
+    if (tail + len == LINE_QUEUE_SIZE) {
+      if (lines == 0) {
+        head = 0;
+        fence = LINE_QUEUE_SIZE;
+      } else if (tail > head && len < head) {
+        fence = tail;
+      } else {
+        return false;
+      }
+      memmove(buffer, buffer + tail, len);
+      tail = 0;
+    }
+    // Wrapped around: stay behind the oldest line
+    return lines == 0 || tail > head || tail + len < head;
+  }
+};
+
+extern LineQueue line_queue;
+
+#ifdef __AVR__
+volatile bool line_pumping = false;  // a timer interrupt is in pump()
+
+// Called with interrupts disabled, returns with them disabled
+void line_pump_isr() {
+  if (line_pumping)
+    return;
+  line_pumping = true;
+  sei();
+  line_queue.pump(Serial);
+  cli();
+  line_pumping = false;
+}
+
+ISR(TIMER0_COMPA_vect) { line_pump_isr(); }
+ISR(TIMER0_COMPB_vect) { line_pump_isr(); }
+#endif
+
+#endif
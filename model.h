@@ -8,16 +8,37 @@
 #define MODEL_H
 
 #include <AD9106.h>
+#include <SPI.h>
 #include "Arduino.h"
+#include "calibration.h"
 #include "config.h"
 #include "global_error.h"
+#include "register_shadow.h"
+#include "wave_synth.h"
 
 extern GlobalError system_error;
 
-class Model {
+/**
+ * @brief Register words for one output state
+ *
+ * Prepared ahead of time by Model::prepare() so that Model::apply() needs no
+ * float math or calibration.
+ */
+struct OutputWords {
+  uint32_t tuning;    // DDS tuning word (24 bit)
+  int16_t gain[4];    // DGAIN word per channel
+  uint16_t phase[4];  // DDSn_PW word per channel
+};
+
+/**
+ * @brief Model of the EVAL-AD9106 board, built for the calibration data of
+ * one card (see config.h)
+ */
+template <class Card>
+class BoardModel {
  public:
   AD9106 dac;
-  Model(int CS) : dac(CS) {};
+  BoardModel(int CS) : dac(CS), cs_pin(CS) {};
 
   /**
    * @brief: Initialize the AD9106 and start SPI communication
@@ -28,6 +49,7 @@ class Model {
 
     // Start SPI communication at 14MHz (Arduino Clock Speed)
     dac.spi_init(14000000);
+    spi_settings = SPISettings(14000000, MSBFIRST, SPI_MODE0);
     reset();
   }
 
@@ -35,7 +57,11 @@ class Model {
    * @brief: Update the AD9106 model with new register values
    */
   void update() {
-    dac.update_pattern();
+    flush();
+    if (defer_update) {
+      return;  // committed by the trigger, see commit()
+    }
+    cardCall(&AD9106::update_pattern);
 
     // Check for errors after updating
     AD9106::ErrorCode err = dac._last_error;
@@ -49,24 +75,204 @@ class Model {
    */
   void reset() {
     // Reset registers
-    dac.reg_reset();
+    cardCall(&AD9106::reg_reset);
+    regs.invalidate();
     delay(1);
 
     // Configure sine waves on each channel
-    for (int i = 1; i < 5; i++) {
-      dac.setDDSsine(CHNL(i));
-    }
+    writeShadowed(REG_WAV4_3CONFIG, WAV_DDS_SINE);
+    writeShadowed(REG_WAV2_1CONFIG, WAV_DDS_SINE);
 
-    // Default Frequency
-    dac.setDDSfreq(50000);
+    // Default Frequency, phase words compensated for it
+    for (int i = 0; i < 4; i++) {
+      phase_words[i] = 0;
+    }
+    writeFreq(50000);
 
     // Characterized phases/amplitides with this pattern period. Not necessary
-    dac.spi_write(dac.PAT_PERIOD, 0x8fff);
+    writeShadowed(REG_PAT_PERIOD, 0x8fff);
+    flush();
+
+    // Forget requested voltages, DGAIN registers are back at their defaults
+    for (int i = 0; i < 4; i++) {
+      voltages[i] = 0;
+    }
+    voltage_set = 0;
   }
 
+  /**
+   * @brief: Make the registers already on the card take effect
+   *
+   * Only issues RAMUPDATE and touches no shadow state, so it is safe to call
+   * from the trigger interrupt, see cardCall().
+   */
+  void commit() { cardCall(&AD9106::update_pattern); }
+
+  /**
+   * @brief: Leave update() at writing registers, without applying them
+   *
+   * Used when an external trigger applies the new state with commit().
+   */
+  void deferUpdates(bool defer) { defer_update = defer; }
+
   // Pattern functions
-  void start() { dac.start_pattern(); }
-  void stop_pattern() { dac.stop_pattern(); }
+  void start() {
+    flush();
+    cardCall(&AD9106::start_pattern);
+  }
+
+  /**
+   * @brief: Start the pattern without writing queued registers
+   *
+   * Touches no shadow state, so it is safe to call from the trigger
+   * interrupt.
+   */
+  void start_pattern() { cardCall(&AD9106::start_pattern); }
+
+  /**
+   * @brief: Stop the pattern, also safe from the trigger interrupt
+   *
+   * While the SRAM is open PAT_STATUS holds PAT_MEM_ACCESS, and clearing it
+   * would cut the SRAM off from later writes. The stop is then kept for
+   * endSram() instead.
+   */
+  void stop_pattern() {
+    if (sram_open) {
+      sram_resume = false;
+      return;
+    }
+    cardCall(&AD9106::stop_pattern);
+  }
+
+  /**
+   * @brief: Check whether the pattern generator is running
+   *
+   * PAT_STATUS is a command/status register outside the shadow, so this
+   * reads the card.
+   */
+  bool isRunning() { return cardRead(AD9106::PAT_STATUS) & 0x01; }
+
+  // Pattern SRAM functions
+
+  /**
+   * @brief: Stop the pattern and open the pattern SRAM to SPI writes
+   *
+   * endSram() starts the pattern again if it was running.
+   */
+  void beginSram() {
+    sram_resume = isRunning();
+    cardCall(&AD9106::stop_pattern);
+    cardWrite(AD9106::PAT_STATUS, PAT_MEM_ACCESS);
+    sram_open = true;
+  }
+
+  /**
+   * @brief: Whether the pattern SRAM is open to writes, between beginSram()
+   * and endSram()
+   */
+  bool sramOpen() { return sram_open; }
+
+  /**
+   * @brief: Write words to the pattern SRAM in one SPI burst
+   *
+   * Between beginSram() and endSram() only.
+   *
+   * @param addr: First SRAM word (0 to SRAM_WORDS - 1)
+   * @param data: Words, uint16 little endian
+   * @param n: Number of words, at least 1
+   */
+  void writeSram(uint16_t addr, const uint8_t* data, uint8_t n) {
+    // Top down, the address decrements as in burstWrite()
+    SPI.beginTransaction(spi_settings);
+    digitalWrite(cs_pin, LOW);
+    SPI.transfer16(SRAM_FIRST + addr + n - 1);
+    for (uint8_t i = n; i > 0; i--) {
+      SPI.transfer16(data[2 * i - 2] | (uint16_t)data[2 * i - 1] << 8);
+    }
+    digitalWrite(cs_pin, HIGH);
+    SPI.endTransaction();
+  }
+
+  /**
+   * @brief: Fill SRAM words start to start + words - 1 with one period of a
+   * waveform computed on the board, see wave_synth.h
+   *
+   * Samples are computed top down, in the order the address decrements,
+   * and sent in bursts of SYNTH_BURST_WORDS, so the trigger interrupt waits
+   * for one burst at most. Values must already be validated.
+   */
+  void synthSram(uint16_t start, uint16_t words, const SynthWave& wave) {
+    beginSram();
+    uint32_t step = 0xffffffffUL / words + 1;  // 2^32 / words
+    uint32_t phase = step * (words - 1);
+    uint16_t add = start + words;
+    while (add > start) {
+      uint16_t n = add - start;
+      if (n > SYNTH_BURST_WORDS) {
+        n = SYNTH_BURST_WORDS;
+      }
+      SPI.beginTransaction(spi_settings);
+      digitalWrite(cs_pin, LOW);
+      SPI.transfer16(SRAM_FIRST + add - 1);
+      for (add -= n; n > 0; n--) {
+        // 12 bit DAC code in [15:4]
+        SPI.transfer16(synth_sample(wave, phase >> 16) & 0xfff0);
+        phase -= step;
+      }
+      digitalWrite(cs_pin, HIGH);
+      SPI.endTransaction();
+    }
+    endSram();
+  }
+
+  /**
+   * @brief: Hand the SRAM back to the pattern generator
+   */
+  void endSram() {
+    sram_open = false;
+    cardWrite(AD9106::PAT_STATUS, 0);
+    if (sram_resume) {
+      start();
+    }
+  }
+
+  /**
+   * @brief: Play a channel from the pattern SRAM, words start to stop
+   *
+   * Values must already be validated.
+   */
+  void setSramSource(int chnl, uint16_t start, uint16_t stop) {
+    writeShadowed(reg_start_addr(chnl), start << 4);
+    writeShadowed(reg_start_addr(chnl) + 1, stop << 4);
+    setWave(chnl, WAVE_SRAM);
+    update();
+  }
+
+  /**
+   * @brief: Play the DDS sine on a channel again
+   */
+  void setSineSource(int chnl) {
+    setWave(chnl, WAVE_SINE);
+    update();
+  }
+
+  /**
+   * @brief: Check whether a channel plays the pattern SRAM
+   */
+  bool isSramSource(int chnl) {
+    uint8_t wave = readReg(reg_wav_config(chnl)) >> ((chnl % 2) ? 0 : 8);
+    return (wave & WAVE_SEL_MASK) == (WAVE_SRAM & WAVE_SEL_MASK);
+  }
+
+  /**
+   * @brief: First and last SRAM word played on a channel
+   */
+  uint16_t getSramStart(int chnl) {
+    return readReg(reg_start_addr(chnl)) >> 4;
+  }
+  uint16_t getSramStop(int chnl) {
+    return readReg(reg_start_addr(chnl) + 1) >> 4;
+  }
 
   /**
    * @brief: Set voltage on channel
@@ -76,148 +282,283 @@ class Model {
    * @returns 0 if voltage was set, 1 otherwise
    */
   int setVoltage(int chnl, float voltage) {
-    float lower_bound = ((float)dac_amp_thesholds[0]) / 10.0;
-    float upper_bound = ((float)dac_amp_thesholds[3]) / 10.0;
-
-    if (voltage < lower_bound || voltage > upper_bound) {
+    if (!voltageInRange(voltage)) {
       system_error.set_error(GenericError::ParamOutOfRange);
       return NULL;
     }
 
     int16_t val = v_to_addr(voltage, chnl);
     if (val != NULL) {
-      dac.set_CHNL_DGAIN(static_cast<CHNL>(chnl), val);
+      writeShadowed(reg_dgain(chnl), val);
+      voltages[chnl - 1] = voltage;
+      voltage_set |= 1 << (chnl - 1);
       return 1;
     }
     return 0;
   }
 
-  float getVoltage(int chnl) { ; }
-
-  // AD9106 register access functions
-  uint16_t readReg(uint16_t add) { return dac.spi_read(add); }
-  void writeReg(uint16_t add, int16_t val) {
-    dac.stop_pattern();
-    dac.spi_write(add, val);
+  /**
+   * @brief: Check a voltage against the calibrated range of the card
+   */
+  bool voltageInRange(float voltage) {
+    constexpr float lower_bound = Card::thresholds[0] / 10.0f;
+    constexpr float upper_bound = Card::thresholds[3] / 10.0f;
+    return lower_bound <= voltage && voltage <= upper_bound;
   }
 
-  // DDS Frequency functions
-  void setFreq(float freq) { dac.setDDSfreq(freq); }
-  float getFreq() { return dac.getDDSfreq(); }
-
   /**
-   * @brief: Set phase on channel
+   * @brief: Set several channel properties with a single update
+   *
+   * Values must already be validated. Every register is written before one
+   * update(), so the new state is applied atomically.
+   *
+   * @param volts: 4 voltages (mV), or NULL to keep the current ones
+   * @param phases: 4 phases (degrees), or NULL to keep the current ones
+   * @param freq: DDS frequency, or negative to keep the current one
    */
-  void setPhase(int chnl, float phase) {
-    if (phase < 0) {
-      phase += 360;
+  void setChannels(const float* volts, const float* phases, float freq = -1) {
+    if (volts != NULL) {
+      for (int i = 0; i < 4; i++) {
+        voltages[i] = volts[i];
+      }
+      voltage_set = 0x0f;
+    }
+    if (freq >= 0) {
+      writeFreq(freq);
+    }
+    if (volts != NULL || freq >= 0) {
+      recalcGains();
+    }
+    if (phases != NULL) {
+      for (int i = 0; i < 4; i++) {
+        setPhase(i + 1, phases[i]);
+      }
     }
+    update();
+  }
 
-    // Define channel 1 to be baseline for phase offsets
-    // if (chnl != 1) {
-    //   float offset = interpolate_offset(chnl);
-    //   // interface.println(offset);
-    //   phase -= offset;
-    // }
+  /**
+   * @brief: Get the last voltage requested on a channel
+   */
+  float getVoltage(int chnl) { return voltages[chnl - 1]; }
 
-    uint16_t val = (uint16_t)round_float(phase * (pow(2, 16) - 1) / 360);
-    dac.set_CHNL_prop(DDS_PHASE, static_cast<CHNL>(chnl), val);
+  /**
+   * @brief: Compute the register words for a state without writing them
+   *
+   * Values must already be validated.
+   *
+   * @param words: Filled in with the tuning, DGAIN and phase words
+   * @param freq: DDS frequency
+   * @param volts: 4 voltages (mV), or NULL for the current ones
+   * @param phases: 4 phases (degrees), or NULL for the current ones
+   *
+   * @returns Bit mask of the channels with a DGAIN word, for apply()
+   */
+  uint8_t prepare(OutputWords& words, float freq, const float* volts,
+                  const float* phases = NULL) {
+    words.tuning = tuningWord(freq);
+    uint32_t freq_q = cal_freq_q(words.tuning * (dac.fclk / 16777216.0f));
+    uint8_t mask = (volts != NULL) ? 0x0f : voltage_set;
+    for (int chnl = 1; chnl < 5; chnl++) {
+      float voltage = (volts != NULL) ? volts[chnl - 1] : voltages[chnl - 1];
+      words.gain[chnl - 1] =
+          (mask & (1 << (chnl - 1)))
+              ? cal_gain_word<Card>(chnl, cal_numerator(voltage), freq_q)
+              : 0;
+      uint16_t phase = (phases != NULL) ? phaseWord(phases[chnl - 1])
+                                        : phase_words[chnl - 1];
+      words.phase[chnl - 1] = phase - phaseOffset(chnl, words.tuning);
+    }
+    return mask;
   }
 
   /**
-   * @brief: Get phase on channel
-   * @param chnl: Channel number
+   * @brief: Restore requested voltages and phases and their prepared
+   * register words
    *
-   * @returns Phase in degrees (-180 to 180)
+   * @param volts: 4 voltages (mV) that the words were prepared for
+   * @param mask: Channels with a requested voltage, from prepare()
+   * @param words: Words from prepare()
    */
-  float getPhase(int chnl) {
-    uint16_t reg_val = dac.get_CHNL_prop(DDS_PHASE, static_cast<CHNL>(chnl));
-    // Brackets important to avoid overflow errors
-    float phase = 360.0f * (reg_val / (pow(2, 16) - 1));
-    if (phase > 180) {
-      phase -= 360;
+  void restore(const float* volts, uint8_t mask, const OutputWords& words) {
+    for (int i = 0; i < 4; i++) {
+      voltages[i] = (mask & (1 << i)) ? volts[i] : 0;
     }
-    return phase;
+    voltage_set = mask;
+    for (int chnl = 1; chnl < 5; chnl++) {
+      phase_words[chnl - 1] =
+          words.phase[chnl - 1] + phaseOffset(chnl, words.tuning);
+    }
+    apply(words, mask);
   }
 
- private:
-  // Interpolate phase offset using offsets array
-  // float interpolate_offset(int chan) {
-  //   float freq = dac.getDDSfreq();
-  //   float f_step = dac.fclk / pow(2, 24);
+  /**
+   * @brief: Write prepared register words and apply them in one update
+   *
+   * Only words that differ from the card are sent. Requested voltages and
+   * phases are left as they are, so the next frequency or voltage command
+   * recalibrates from them.
+   *
+   * @param words: Words from prepare()
+   * @param gain_mask: Channels whose DGAIN word to write
+   */
+  void apply(const OutputWords& words, uint8_t gain_mask) {
+    stage(words, gain_mask);
+    update();
+  }
 
-  //   // get pointer to offset array for channel in PROGMEM
-  //   const int* offset_ptr =
-  //       (const int*)pgm_read_word_near(&(dacphase_offsets[chan - 2]));
+  /**
+   * @brief: Write prepared register words without applying them
+   *
+   * The card keeps them until the next RAMUPDATE, see commit().
+   */
+  void stage(const OutputWords& words, uint8_t gain_mask) {
+    writeShadowed(REG_DDS_TW32, words.tuning >> 8);
+    writeShadowed(REG_DDS_TW1, (words.tuning & 0xff) << 8);
+    for (int chnl = 1; chnl < 5; chnl++) {
+      if (gain_mask & (1 << (chnl - 1)))
+        writeShadowed(reg_dgain(chnl), words.gain[chnl - 1]);
+      writeShadowed(reg_dds_pw(chnl), words.phase[chnl - 1]);
+    }
+    flush();
+  }
 
-  //   if (offset_ptr == NULL) {
-  //     return 0;
-  //   }
+  // AD9106 register access functions
 
-  //   int index = _get_index(&freq);
-  //   int freq_val = _get_freq_val(index, f_step);
-  //   // TODO: add offsets for frequency vals up to 15 to avoid ugly code here
-  //   if (freq_val <= 15 && !(freq_val == 11 || freq_val == 13)) {
-  //     int offset = (int)pgm_read_word_near(offset_ptr + freq_val - 1);
-  //     return (float)offset / 10000.0;
-  //   }
-  //   if (f_step * _get_freq_val(index, f_step) > freq) {
-  //     index -= 1;
-  //   }
+  /**
+   * @brief: Read a register, from the shadow copy when it is known
+   */
+  uint16_t readReg(uint16_t add) {
+    if (regs.covers(add) && regs.isValid(add)) {
+      return regs.get(add);
+    }
+    uint16_t val = cardRead(add);
+    if (regs.covers(add)) {
+      regs.load(add, val);
+    }
+    return val;
+  }
 
-  //   float freq_1 = f_step * _get_freq_val(index + 1, f_step);
-  //   float freq_2 = f_step * _get_freq_val(index, f_step);
+  /**
+   * @brief: Queue a raw register write, skipping unchanged values
+   *
+   * The pattern is stopped once when the queue is flushed rather than on
+   * every write. Registers outside the shadow go out immediately.
+   */
+  void writeReg(uint16_t add, int16_t val) {
+    if (!regs.covers(add)) {
+      cardCall(&AD9106::stop_pattern);
+      cardWrite(add, val);
+      return;
+    }
+    if (regs.set(add, val)) {
+      stop_pending = true;
+    }
+  }
 
-  //   index -=
-  //       8;  // subtract 8 for removal of duplicates in offset array (see SOP)
-  //   int off_1 = pgm_read_word_near(offset_ptr + index + 1);
-  //   int off_2 = pgm_read_word_near(offset_ptr + index);
+  /**
+   * @brief: Write pending values, then reload the shadow from the card
+   *
+   * For recovering after the card was changed behind the model's back
+   */
+  void resync() {
+    flush();
+    for (uint16_t add = SHADOW_FIRST; add <= SHADOW_LAST; add++) {
+      regs.load(add, cardRead(add));
+    }
+  }
 
-  //   float off_1f = (float)off_1 / 10000.0;
-  //   float off_2f = (float)off_2 / 10000.0;
+  // DDS Frequency functions
 
-  //   float slope = (float)(off_1f - off_2f) / (freq_1 - freq_2);
+  /**
+   * @brief: Set DDS frequency and re-calibrate channel amplitudes
+   *
+   * The amplitude calibration depends on frequency, so the DGAIN word of
+   * every channel with a requested voltage is recomputed at the new frequency
+   * and committed together with it in a single update.
+   */
+  void setFreq(float freq) {
+    writeFreq(freq);
+    recalcGains();
+    update();
+  }
 
-  //   return slope * (freq - freq_1) + off_1f;
-  // }
+  /**
+   * @brief: Get DDS frequency from the tuning word
+   */
+  float getFreq() { return getTuning() * (dac.fclk / 16777216.0f); }
 
-  // int _get_index(float* freq) {
-  //   float index = (log10(*freq) - 1) * 69 / 4;
-  //   return round(index);
-  // }
+  /**
+   * @brief: Get the DDS tuning word
+   */
+  uint32_t getTuning() {
+    return ((uint32_t)readReg(REG_DDS_TW32) << 8) |
+           (readReg(REG_DDS_TW1) >> 8);
+  }
 
-  // int _get_freq_val(int index, float f_step) {
-  //   // index * 4/69. Hardcoded to avoid floating point errors
-  //   float inc = (float)index * (4.0 / 69);
-  //   float val = pow(10, 1 + inc);
-  //   return round_float(val / f_step);
-  // }
+  /**
+   * @brief: Set phase on channel, compensated for the channel's phase offset
+   * at the current frequency
+   */
+  void setPhase(int chnl, float phase) {
+    phase_words[chnl - 1] = phaseWord(phase);
+    writeShadowed(reg_dds_pw(chnl),
+                  phase_words[chnl - 1] - phaseOffset(chnl, getTuning()));
+  }
 
-  int round_float(float num) {
-    return (num >= 0) ? (int)(num + 0.5f) : (int)(num - 0.5f);
+  /**
+   * @brief: Get the last phase requested on a channel
+   * @param chnl: Channel number
+   *
+   * @returns Phase in degrees (-180 to 180)
+   */
+  float getPhase(int chnl) {
+    uint16_t reg_val = phase_words[chnl - 1];
+    // Brackets important to avoid overflow errors
+    float phase = 360.0f * (reg_val / (pow(2, 16) - 1));
+    if (phase > 180) {
+      phase -= 360;
+    }
+    return phase;
   }
 
   /**
    * @brief: Convert voltage to value for address
    *
+   * Fixed-point evaluation of the calibration fit, see calibration.h
+   *
    * @param voltage: Voltage to convert
    * @param chan: Channel number
    *
    * @returns value for address
    */
   int16_t v_to_addr(float voltage, int chan) {
-    // const float *coeffs =  (const float*) pgm_read_ptr(&(dac_amp_coeffs[chan
-    // - 1]));
+    return cal_gain_word<Card>(chan, cal_numerator(voltage),
+                               cal_freq_q(getFreq()));
+  }
+
+  /**
+   * @brief: Reference float evaluation of the calibration fit
+   *
+   * Kept to check and benchmark v_to_addr against.
+   *
+   * @param voltage: Voltage to convert
+   * @param chan: Channel number
+   *
+   * @returns value for address
+   */
+  int16_t v_to_addr_float(float voltage, int chan) {
     int range_index = 0;
     for (int i = 0; i < 3; i++) {
-      if (dac_amp_thesholds[i] / 10 <= voltage &&
-          voltage <= dac_amp_thesholds[i + 1] / 10) {
+      int lower = (int16_t)pgm_read_word_near(&Card::thresholds[i]) / 10;
+      int upper = (int16_t)pgm_read_word_near(&Card::thresholds[i + 1]) / 10;
+      if (lower <= voltage && voltage <= upper) {
         range_index = 6 * i;
         break;
       }
     }
 
-    float freq = dac.getDDSfreq();
+    float freq = getFreq();
     float float_reader_buff;
 
     // absorb factor of 10^(-5) from fit function
@@ -227,7 +568,8 @@ class Model {
     int freq_order = get_order(freq);
     for (int i = 0; i < 4; i++) {
       // get difference in magnitudes of polynomial term
-      int order_diff = (exps[i] - 5) - freq_order * (i + 1);
+      int exp = (int8_t)pgm_read_byte_near(&Card::exps[i]);
+      int order_diff = (exp - 5) - freq_order * (i + 1);
       if (-10 <= order_diff && order_diff <= 10) {
         float freq_sigval = freq / pow(10, freq_order);
         read_pgm_float(chan, range_index + i, &float_reader_buff);
@@ -241,8 +583,186 @@ class Model {
     return addr;
   }
 
+ private:
+  RegisterShadow regs;  // also the write queue, see flush()
+  int cs_pin;
+  SPISettings spi_settings;
+  bool stop_pending = false;  // a queued raw write needs the pattern stopped
+  bool defer_update = false;  // update() leaves RAMUPDATE to commit()
+  volatile bool sram_resume = false;  // pattern was running before beginSram()
+  volatile bool sram_open = false;    // between beginSram() and endSram()
+  float voltages[4] = {0, 0, 0, 0};  // requested voltage per channel (mV)
+  uint8_t voltage_set = 0;           // bit n-1 set once channel n has a voltage
+  uint16_t phase_words[4] = {0, 0, 0, 0};  // requested phase, uncompensated
+  uint32_t offset_tw = 0xffffffff;         // tuning word offsets[] are for
+  int16_t offsets[4];                      // phase offset per channel (LSB)
+
+  /**
+   * @brief: Recompute DGAIN for every channel that has a requested voltage
+   */
+  void recalcGains() {
+    uint32_t freq_q = cal_freq_q(getFreq());
+    for (int chnl = 1; chnl < 5; chnl++) {
+      if (!(voltage_set & (1 << (chnl - 1))))
+        continue;
+      int16_t val =
+          cal_gain_word<Card>(chnl, cal_numerator(voltages[chnl - 1]),
+                              freq_q);
+      writeShadowed(reg_dgain(chnl), val);
+    }
+  }
+
+  /**
+   * @brief: Queue a register value, skipping it if the card already has it
+   *
+   * Queued values reach the card at the next flush(), which update(),
+   * start() and reset() all do first.
+   */
+  void writeShadowed(uint16_t add, uint16_t val) {
+    if (!regs.covers(add)) {
+      cardWrite(add, val);
+      return;
+    }
+    regs.set(add, val);
+  }
+
+  /**
+   * @brief: Write every queued register to the card
+   *
+   * The dirty bits of the shadow act as the write queue: repeated writes to
+   * an address have already merged, and scanning the window visits them in
+   * address order. Runs of dirty registers go out as one SPI burst each. A
+   * single known register between two dirty ones is rewritten to join the
+   * runs, which is cheaper than a new instruction word.
+   */
+  void flush() {
+    if (stop_pending) {
+      cardCall(&AD9106::stop_pattern);
+      stop_pending = false;
+    }
+    for (int add = SHADOW_LAST; add >= SHADOW_FIRST; add--) {
+      if (!regs.isDirty(add))
+        continue;
+      int low = add;
+      while (low > SHADOW_FIRST) {
+        if (regs.isDirty(low - 1)) {
+          low--;
+        } else if (low - 2 >= SHADOW_FIRST && regs.isValid(low - 1) &&
+                   regs.isDirty(low - 2)) {
+          low -= 2;
+        } else {
+          break;
+        }
+      }
+      burstWrite(add, low);
+      add = low;
+    }
+  }
+
+  /*
+   * The AD9106 driver does not use SPI transactions itself, so every driver
+   * call and every burst below runs inside one. SPI.usingInterrupt() in
+   * Trigger::begin() then holds the trigger interrupt off until the frame
+   * in progress is complete, and the ISR can write to the card itself.
+   */
+  void cardCall(void (AD9106::*call)()) {
+    SPI.beginTransaction(spi_settings);
+    (dac.*call)();
+    SPI.endTransaction();
+  }
+
+  void cardWrite(uint16_t add, uint16_t val) {
+    SPI.beginTransaction(spi_settings);
+    dac.spi_write(add, val);
+    SPI.endTransaction();
+  }
+
+  uint16_t cardRead(uint16_t add) {
+    SPI.beginTransaction(spi_settings);
+    uint16_t val = dac.spi_read(add);
+    SPI.endTransaction();
+    return val;
+  }
+
+  /**
+   * @brief: Stream shadow values for addresses top down to low in one
+   * SPI transaction, using the AD9106's default auto-decrementing address
+   */
+  void burstWrite(uint16_t top, uint16_t low) {
+    SPI.beginTransaction(spi_settings);
+    digitalWrite(cs_pin, LOW);
+    SPI.transfer16(top);  // R/W bit clear: write
+    for (uint16_t add = top; add >= low; add--) {
+      SPI.transfer16(regs.get(add));
+      regs.markClean(add);
+    }
+    digitalWrite(cs_pin, HIGH);
+    SPI.endTransaction();
+  }
+
+  /**
+   * @brief: Queue the WAVx_yCONFIG byte of one channel
+   */
+  void setWave(int chnl, uint8_t wave) {
+    uint16_t add = reg_wav_config(chnl);
+    uint8_t shift = (chnl % 2) ? 0 : 8;
+    writeShadowed(add, (readReg(add) & ~(0xff << shift)) | wave << shift);
+  }
+
+  /**
+   * @brief: DDSn_PW word for a phase in degrees (-180 to 180), before
+   * offset compensation
+   */
+  uint16_t phaseWord(float phase) {
+    if (phase < 0) {
+      phase += 360;
+    }
+    return (uint16_t)round_float(phase * (pow(2, 16) - 1) / 360);
+  }
+
+  /**
+   * @brief: Phase offset of a channel against channel 1, see calibration.h
+   *
+   * The offsets of all channels are cached for the last tuning word, so
+   * setting phases at a fixed frequency interpolates only once.
+   */
+  int16_t phaseOffset(int chnl, uint32_t tw) {
+    if (tw != offset_tw) {
+      for (int i = 0; i < 4; i++) {
+        offsets[i] = cal_phase_offset(i + 1, tw);
+      }
+      offset_tw = tw;
+    }
+    return offsets[chnl - 1];
+  }
+
+  /**
+   * @brief: DDS tuning word for a frequency
+   */
+  uint32_t tuningWord(float freq) {
+    return (uint32_t)(freq * (16777216.0f / dac.fclk) + 0.5f);
+  }
+
+  /**
+   * @brief: Stage the DDS tuning word for a frequency, and the phase words
+   * compensated for it
+   */
+  void writeFreq(float freq) {
+    uint32_t tw = tuningWord(freq);
+    writeShadowed(REG_DDS_TW32, tw >> 8);
+    writeShadowed(REG_DDS_TW1, (tw & 0xff) << 8);
+    for (int chnl = 1; chnl < 5; chnl++) {
+      writeShadowed(reg_dds_pw(chnl),
+                    phase_words[chnl - 1] - phaseOffset(chnl, tw));
+    }
+  }
+
+  int round_float(float num) {
+    return (num >= 0) ? (int)(num + 0.5f) : (int)(num - 0.5f);
+  }
+
   void read_pgm_float(int chan, int index, float* dest) {
-    *dest = pgm_read_float_near(&dac_amp_coeffs[chan - 1][index]);
+    *dest = pgm_read_float_near(&Card::amp_coeffs[chan - 1][index]);
   }
 
   // float _get_amp_addr(float voltage, const float coeffs[6]) {
@@ -267,4 +787,6 @@ class Model {
   // }
 };
 
+typedef BoardModel<AD9106Card> Model;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+/******************************************************************************
+    @file:  presets.h
+
+    @brief: Instrument setups stored in EEPROM for *SAV / *RCL
+******************************************************************************/
+
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <EEPROM.h>
+#include "Arduino.h"
+#include "config.h"
+#include "model.h"
+
+const uint8_t PRESET_SLOTS = 8;
+// Marks a slot as holding a Preset. Change it whenever the Preset layout,
+// the calibration or the meaning of a stored word changes, so stale register
+// words are never recalled. 0xa2: phase words hold the compensated offset.
+// 0xa3: card id added.
+const uint8_t PRESET_MAGIC = 0xa3;
+
+struct Preset {
+  uint8_t magic;
+  uint8_t card;          // AD9106Card::id, the words only suit that card
+  uint8_t display_mode;  // ViewState::Mode
+  uint8_t voltage_mask;  // channels with a requested voltage
+  float freq;
+  float volts[4];
+  float phases[4];
+  OutputWords words;  // prepared for the values above
+};
+
+/**
+ * @brief EEPROM address of a preset slot
+ */
+int preset_addr(uint8_t slot) {
+  return EEPROM_PRESET_ADDR + slot * sizeof(Preset);
+}
+
+/**
+ * @brief Reads a preset slot
+ *
+ * @return true if the slot holds a preset saved with this card
+ */
+bool read_preset(uint8_t slot, Preset& preset) {
+  EEPROM.get(preset_addr(slot), preset);
+  return preset.magic == PRESET_MAGIC && preset.card == AD9106Card::id;
+}
+
+/**
+ * @brief Writes a preset slot. Unchanged bytes are not rewritten.
+ */
+void write_preset(uint8_t slot, Preset& preset) {
+  preset.magic = PRESET_MAGIC;
+  preset.card = AD9106Card::id;
+  EEPROM.put(preset_addr(slot), preset);
+}
+
+#endif
@@ -0,0 +1,132 @@
+/******************************************************************************
+    @file:  ram_guard.h
+
+    @brief: SRAM measurements and a watch on the free RAM between the heap
+            and the stack
+******************************************************************************/
+
+#ifndef RAM_GUARD_H
+#define RAM_GUARD_H
+
+#include "Arduino.h"
+#include "global_error.h"
+
+extern GlobalError system_error;
+
+// Below this many free bytes a LowMemory error is raised. Leaves room for
+// the deepest handler and an interrupt on top of the sampled stack.
+const int RAM_LOW_BYTES = 160;
+// The error is raised again only after the gap recovered by this much
+const int RAM_REARM_BYTES = 64;
+
+// Build-time budget for the sketch's globals, checked at the end of
+// ACDAC_box_driver.ino. Of the 2 KB the core keeps about RAM_CORE_BYTES
+// (Serial's two 64 byte buffers, vtables, millis() state) and the stack
+// needs the deepest handler plus RAM_LOW_BYTES.
+const int RAM_SIZE = 2048;
+const int RAM_CORE_BYTES = 200;
+const int RAM_STACK_BYTES = 256;
+const int RAM_STATIC_BUDGET = RAM_SIZE - RAM_CORE_BYTES - RAM_STACK_BYTES;
+
+#ifdef __AVR__
+extern char __data_start;
+extern char __heap_start;  // end of .data and .bss
+extern char* __brkval;
+extern char __stack;  // RAMEND
+
+// Fill of the unused RAM at boot, see stack_high_water()
+const uint8_t STACK_PAINT = 0xc5;
+
+/**
+ * @brief Fills everything above .bss with STACK_PAINT
+ *
+ * Runs from .init1, before the stack pointer and r1 are set up, hence the
+ * plain assembly. Costs about 1 ms at boot.
+ */
+void paint_stack() __attribute__((naked, used, section(".init1")));
+void paint_stack() {
+  asm volatile(
+      "  ldi r30, lo8(__heap_start)\n"
+      "  ldi r31, hi8(__heap_start)\n"
+      "  ldi r24, %0\n"
+      "  ldi r25, hi8(__stack)\n"
+      "  rjmp 2f\n"
+      "1:\n"
+      "  st Z+, r24\n"
+      "2:\n"
+      "  cpi r30, lo8(__stack)\n"
+      "  cpc r31, r25\n"
+      "  brlo 1b\n"
+      "  breq 1b\n" ::"M"(STACK_PAINT));
+}
+
+/**
+ * @brief Bytes between the top of the heap and the stack pointer
+ */
+int free_ram() {
+  char top;
+  return &top - (__brkval == 0 ? &__heap_start : __brkval);
+}
+
+/**
+ * @brief Most stack ever used since boot, interrupts included
+ *
+ * Counts the paint left between the heap and the stack. Only reads RAM, so
+ * it is fine to query in production.
+ */
+int stack_high_water() {
+  const char* p = (__brkval == 0) ? &__heap_start : __brkval;
+  while (p <= &__stack && *p == (char)STACK_PAINT)
+    p++;
+  return &__stack - p + 1;
+}
+
+/**
+ * @brief Bytes the heap has grown to (0, nothing allocates)
+ */
+int heap_size() { return (__brkval == 0) ? 0 : __brkval - &__heap_start; }
+
+/**
+ * @brief Bytes of .data and .bss, all globals and static buffers
+ */
+int static_ram() { return &__heap_start - &__data_start; }
+#else
+// host/host_sim.cpp
+int free_ram();
+int stack_high_water();
+int heap_size();
+int static_ram();
+#endif
+
+/*
+ * The firmware never allocates (see the poison in ACDAC_box_driver.ino), so
+ * the heap stays empty and the gap only shrinks as the stack grows. check()
+ * is called from the loop and from the dispatcher right before a handler
+ * runs, the deepest points that are cheap to reach.
+ */
+class RamGuard {
+ public:
+  int min_free = 0x7fff;  // smallest gap seen since power on
+
+  /**
+   * @brief Samples the gap, raises LowMemory once when it runs low
+   */
+  void check() {
+    int gap = free_ram();
+    if (gap < min_free)
+      min_free = gap;
+    if (!low && gap < RAM_LOW_BYTES) {
+      low = true;
+      system_error.set_error(GenericError::LowMemory);
+    } else if (low && gap >= RAM_LOW_BYTES + RAM_REARM_BYTES) {
+      low = false;
+    }
+  }
+
+ private:
+  bool low = false;
+};
+
+extern RamGuard ram_guard;
+
+#endif
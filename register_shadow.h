@@ -0,0 +1,131 @@
+/******************************************************************************
+    @file:  register_shadow.h
+
+    @brief: RAM copy of the AD9106 registers written by the Model
+******************************************************************************/
+
+#ifndef REGISTER_SHADOW_H
+#define REGISTER_SHADOW_H
+
+#include "Arduino.h"
+
+// AD9106 register addresses used by the Model (see AD9106 datasheet)
+const uint16_t REG_WAV4_3CONFIG = 0x26;
+const uint16_t REG_WAV2_1CONFIG = 0x27;
+const uint16_t REG_PAT_PERIOD = 0x29;
+const uint16_t REG_DDS_TW32 = 0x3e;  // DDS tuning word [23:8]
+const uint16_t REG_DDS_TW1 = 0x3f;   // DDS tuning word [7:0] in bits [15:8]
+
+// WAVx_yCONFIG value selecting the prestored DDS sine (PRESTORE_SEL = 3,
+// WAVE_SEL = 1) for both channels of the register
+const uint16_t WAV_DDS_SINE = 0x3131;
+
+// WAVE_SEL of one channel's byte in WAVx_yCONFIG: the prestored DDS sine, or
+// the pattern SRAM played from START_ADDRn to STOP_ADDRn (WAVE_SEL = 0)
+const uint8_t WAVE_SINE = 0x31;
+const uint8_t WAVE_SRAM = 0x30;
+const uint8_t WAVE_SEL_MASK = 0x03;
+
+// PAT_STATUS bit giving SPI access to the pattern SRAM, pattern stopped
+const uint16_t PAT_MEM_ACCESS = 0x04;
+
+// Pattern SRAM, one 16 bit word per address with the DAC code in [15:4]
+const uint16_t SRAM_FIRST = 0x6000;
+const uint16_t SRAM_WORDS = 4096;
+
+// DACn_DGAIN and DDSn_PW registers count down from channel 1
+uint16_t reg_dgain(int chnl) { return 0x36 - chnl; }
+uint16_t reg_dds_pw(int chnl) { return 0x44 - chnl; }
+
+// START_ADDRn, STOP_ADDRn follows it, in blocks of 4 down from channel 1
+uint16_t reg_start_addr(int chnl) { return 0x61 - 4 * chnl; }
+
+// WAVx_yCONFIG holding a channel, odd channels in the low byte
+uint16_t reg_wav_config(int chnl) {
+  return (chnl < 3) ? REG_WAV2_1CONFIG : REG_WAV4_3CONFIG;
+}
+
+// Shadowed window: PAT_TYPE (0x1f) to DDS_CYC1 (0x5f). RAMUPDATE and
+// PAT_STATUS below it are command/status registers and always go to the card.
+const uint16_t SHADOW_FIRST = 0x1f;
+const uint16_t SHADOW_LAST = 0x5f;
+const uint8_t SHADOW_SIZE = SHADOW_LAST - SHADOW_FIRST + 1;
+
+class RegisterShadow {
+ public:
+  RegisterShadow() { invalidate(); }
+
+  /**
+   * @brief Checks if an address lies in the shadowed window
+   */
+  bool covers(uint16_t addr) {
+    return SHADOW_FIRST <= addr && addr <= SHADOW_LAST;
+  }
+
+  /**
+   * @brief Checks if the shadow holds a known value for an address
+   */
+  bool isValid(uint16_t addr) { return test(valid, addr); }
+
+  /**
+   * @brief Checks if an address holds a value not yet written to the card
+   */
+  bool isDirty(uint16_t addr) { return test(dirty, addr); }
+
+  uint16_t get(uint16_t addr) { return values[addr - SHADOW_FIRST]; }
+
+  /**
+   * @brief Stages a new value for an address
+   *
+   * @return true if the value differs from the known card contents
+   */
+  bool set(uint16_t addr, uint16_t val) {
+    if (isValid(addr) && get(addr) == val)
+      return false;
+    values[addr - SHADOW_FIRST] = val;
+    mark(valid, addr);
+    mark(dirty, addr);
+    return true;
+  }
+
+  /**
+   * @brief Records a value known to be on the card (read back or written)
+   */
+  void load(uint16_t addr, uint16_t val) {
+    values[addr - SHADOW_FIRST] = val;
+    mark(valid, addr);
+    clear(dirty, addr);
+  }
+
+  void markClean(uint16_t addr) { clear(dirty, addr); }
+
+  /**
+   * @brief Forgets every value, e.g. after a register reset of the card
+   */
+  void invalidate() {
+    for (uint8_t i = 0; i < sizeof(valid); i++) {
+      valid[i] = 0;
+      dirty[i] = 0;
+    }
+  }
+
+ private:
+  uint16_t values[SHADOW_SIZE];
+  uint8_t valid[(SHADOW_SIZE + 7) / 8];
+  uint8_t dirty[(SHADOW_SIZE + 7) / 8];
+
+  bool test(const uint8_t* bits, uint16_t addr) {
+    uint8_t i = addr - SHADOW_FIRST;
+    return bits[i >> 3] & (1 << (i & 7));
+  }
+  void mark(uint8_t* bits, uint16_t addr) {
+    uint8_t i = addr - SHADOW_FIRST;
+    bits[i >> 3] |= (1 << (i & 7));
+  }
+  void clear(uint8_t* bits, uint16_t addr) {
+    uint8_t i = addr - SHADOW_FIRST;
+    bits[i >> 3] &= ~(1 << (i & 7));
+  }
+};
+
+#endif
@@ -0,0 +1,159 @@
+/******************************************************************************
+    @file:  scheduler.h
+
+    @brief: Cooperative scheduler for the work done from loop()
+******************************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+
+const uint8_t SCHED_TASKS = 6;  // task slots, 18 bytes of RAM each
+
+// Task flags
+const uint8_t SCHED_ONCE = 0x01;   // runs once when armed with once()
+const uint8_t SCHED_ARMED = 0x02;  // waiting to run
+
+struct Task {
+  void (*run)();
+  const __FlashStringHelper* name;
+  uint32_t due_ms;     // next run
+  uint16_t period_ms;  // 0 runs on every pass
+  uint16_t budget_us;  // expected longest run
+  uint16_t worst_us;   // longest run seen, saturates at 65535
+  uint8_t overruns;    // runs over budget_us, saturates at 255
+  uint8_t priority;    // 0 runs first
+  uint8_t flags;
+};
+
+/*
+ * One call of run() is one pass: every task that is due runs once, in
+ * priority order. Tasks cannot be preempted, so a pass takes as long as the
+ * tasks in it, and input waits at most one pass. The worst pass and the
+ * worst run of every task are kept to show whether that stays bounded as
+ * tasks are added. Runs longer than a task's budget are counted, not cut
+ * short.
+ */
+class Scheduler {
+ public:
+  uint16_t worst_pass_us = 0;  // longest pass seen, saturates at 65535
+
+  /**
+   * @brief Adds a periodic task
+   *
+   * @param period_ms Time between runs, 0 runs on every pass
+   * @return Task id, or SCHED_TASKS if all slots are taken
+   */
+  uint8_t every(const __FlashStringHelper* name, void (*run)(),
+                uint16_t period_ms, uint8_t priority, uint16_t budget_us) {
+    uint8_t id = add(name, run, priority, budget_us);
+    if (id < SCHED_TASKS) {
+      tasks[id].period_ms = period_ms;
+      tasks[id].flags = SCHED_ARMED;
+      tasks[id].due_ms = millis();
+    }
+    return id;
+  }
+
+  /**
+   * @brief Adds a one-shot task, idle until armed with once()
+   *
+   * @return Task id, or SCHED_TASKS if all slots are taken
+   */
+  uint8_t oneShot(const __FlashStringHelper* name, void (*run)(),
+                  uint8_t priority, uint16_t budget_us) {
+    uint8_t id = add(name, run, priority, budget_us);
+    if (id < SCHED_TASKS)
+      tasks[id].flags = SCHED_ONCE;
+    return id;
+  }
+
+  /**
+   * @brief Runs a one-shot task after a delay, replacing an earlier request
+   */
+  void once(uint8_t id, uint16_t delay_ms) {
+    if (id >= size)
+      return;
+    tasks[id].due_ms = millis() + delay_ms;
+    tasks[id].flags |= SCHED_ARMED;
+  }
+
+  /**
+   * @brief Runs one pass over the due tasks
+   */
+  void run() {
+    unsigned long pass_start = micros();
+    for (uint8_t i = 0; i < size; i++) {
+      Task& task = tasks[order[i]];
+      if (!(task.flags & SCHED_ARMED) ||
+          (long)(millis() - task.due_ms) < 0)
+        continue;
+
+      if (task.flags & SCHED_ONCE)
+        task.flags &= ~SCHED_ARMED;
+      else if (task.period_ms > 0)
+        task.due_ms += task.period_ms;
+
+      unsigned long start = micros();
+      task.run();
+      record(task, micros() - start);
+
+      // Skip missed periods instead of running back to back
+      if (task.period_ms > 0 && (long)(millis() - task.due_ms) >= 0)
+        task.due_ms = millis() + task.period_ms;
+    }
+    unsigned long pass_us = micros() - pass_start;
+    if (pass_us > worst_pass_us)
+      worst_pass_us = (pass_us > 0xffff) ? 0xffff : pass_us;
+  }
+
+  uint8_t count() { return size; }
+
+  /**
+   * @brief Task by id, ids are in the order tasks were added
+   */
+  const Task& task(uint8_t id) { return tasks[id]; }
+
+ private:
+  Task tasks[SCHED_TASKS];
+  uint8_t order[SCHED_TASKS];  // task ids by priority
+  uint8_t size = 0;
+
+  uint8_t add(const __FlashStringHelper* name, void (*run)(),
+              uint8_t priority, uint16_t budget_us) {
+    if (size >= SCHED_TASKS)
+      return SCHED_TASKS;
+    Task& task = tasks[size];
+    task.run = run;
+    task.name = name;
+    task.due_ms = 0;
+    task.period_ms = 0;
+    task.budget_us = budget_us;
+    task.worst_us = 0;
+    task.overruns = 0;
+    task.priority = priority;
+    task.flags = 0;
+
+    // Insertion sort, equal priorities keep the order they were added in
+    uint8_t i = size;
+    while (i > 0 && tasks[order[i - 1]].priority > priority) {
+      order[i] = order[i - 1];
+      i--;
+    }
+    order[i] = size;
+    return size++;
+  }
+
+  void record(Task& task, unsigned long us) {
+    uint16_t clamped = (us > 0xffff) ? 0xffff : us;
+    if (clamped > task.worst_us)
+      task.worst_us = clamped;
+    if (clamped > task.budget_us && task.overruns < 0xff)
+      task.overruns++;
+  }
+};
+
+extern Scheduler scheduler;
+
+#endif
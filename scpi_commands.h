@@ -0,0 +1,168 @@
+/******************************************************************************
+    @file:  scpi_commands.h
+
+    @brief: SCPI keywords and command table, see scpi_dispatch.h
+******************************************************************************/
+
+#ifndef SCPI_COMMANDS_H
+#define SCPI_COMMANDS_H
+
+#include <avr/pgmspace.h>
+#include "command_handlers.h"
+#include "scpi_dispatch.h"
+
+/*
+ * Keywords in flash. A token matches the upper case short form or the whole
+ * keyword, so keywords sharing a short form match in this order (STAT is
+ * STATe). "#" marks a keyword taking a number, which handlers get as
+ * `suffix`.
+ */
+#define SCPI_KEYWORDS(X)          \
+  X(IDN, "*IDN")                  \
+  X(RCL, "*RCL")                  \
+  X(RST, "*RST")                  \
+  X(SAV, "*SAV")                  \
+  X(TRG, "*TRG")                  \
+  X(ACTION, "ACTion")             \
+  X(ALL, "ALL")                   \
+  X(APPEND, "APPend")             \
+  X(BAUD, "BAUD")                 \
+  X(BENCHMARK, "BENCHmark")       \
+  X(BINARY, "BINary")             \
+  X(CALIBRATION, "CALibration")   \
+  X(CHANNEL, "CHANnel#")          \
+  X(CLEAR, "CLEar")               \
+  X(COMMUNICATE, "COMMunicate")   \
+  X(CONFIRM, "CONFirm")           \
+  X(COUNT, "COUNt")               \
+  X(DISPLAY, "DISPlay")           \
+  X(ERROR, "ERRor")               \
+  X(FREQUENCY, "FREQuency")       \
+  X(LIST, "LIST")                 \
+  X(LOAD, "LOAD")                 \
+  X(MEMORY, "MEMory")             \
+  X(MODE, "MODE")                 \
+  X(PATTERN, "PATtern")           \
+  X(PHASE, "PHASe")               \
+  X(REGISTER, "REGister")         \
+  X(SAVE, "SAVE")                 \
+  X(SHAPE, "SHAPe")               \
+  X(SLOPE, "SLOPe")               \
+  X(SOURCE, "SOURce")             \
+  X(START, "STARt")               \
+  X(STATE, "STATe")               \
+  X(STATISTICS, "STATistics")     \
+  X(STOP, "STOP")                 \
+  X(SWEEP, "SWEep")               \
+  X(SYNC, "SYNC")                 \
+  X(SYS, "SYS")                   \
+  X(TASK, "TASK")                 \
+  X(TRACE, "TRACe")               \
+  X(TRIGGER, "TRIGger")           \
+  X(UPDATE, "UPDate")             \
+  X(VOLTAGE, "VOLTage")
+
+#define KW_ENUM(id, text) KW_##id,
+#define KW_STRING(id, text) const char kw_##id[] PROGMEM = text;
+#define KW_POINTER(id, text) kw_##id,
+
+enum ScpiKeyword : uint8_t { KW_NONE, SCPI_KEYWORDS(KW_ENUM) KW_END };
+
+SCPI_KEYWORDS(KW_STRING)
+const char* const scpi_keywords[] PROGMEM = {SCPI_KEYWORDS(KW_POINTER)};
+
+#undef KW_ENUM
+#undef KW_STRING
+#undef KW_POINTER
+
+static_assert(KW_END <= (1 << SCPI_KEY_BITS), "Too many SCPI keywords");
+
+constexpr ScpiCommand scpi_commands[] PROGMEM = {
+    // Root Commands
+    {scpi_key(QUERY, KW_IDN), handleIdentify},
+    {scpi_key(SET, KW_RST), handleReset},
+    {scpi_key(SET, KW_SAV), handleSave},
+    {scpi_key(SET, KW_RCL), handleRecall},
+    {scpi_key(SET, KW_FREQUENCY), handleSetFreq},
+    {scpi_key(QUERY, KW_FREQUENCY), handleGetFreq},
+    {scpi_key(SET, KW_TRG), handleBusTrigger},
+    {scpi_key(QUERY, KW_TRIGGER), handleGetTrig},
+
+    // System Commands
+    {scpi_key(QUERY, KW_SYS, KW_ERROR), GetLastEror},
+    {scpi_key(QUERY, KW_SYS, KW_ERROR, KW_ALL), handleGetAllErrors},
+    {scpi_key(QUERY, KW_SYS, KW_STATE), handleGetState},
+    {scpi_key(QUERY, KW_SYS, KW_MEMORY), handleGetMemory},
+    {scpi_key(QUERY, KW_SYS, KW_TASK), handleGetTasks},
+    {scpi_key(QUERY, KW_SYS, KW_REGISTER), handleGetReg},
+    {scpi_key(SET, KW_SYS, KW_REGISTER), handleSetReg},
+    {scpi_key(SET, KW_SYS, KW_REGISTER, KW_SYNC), handleSyncReg},
+    {scpi_key(SET, KW_SYS, KW_DISPLAY, KW_MODE), changeMode},
+    {scpi_key(QUERY, KW_SYS, KW_CALIBRATION, KW_BENCHMARK),
+     handleCalBenchmark},
+    {scpi_key(SET, KW_SYS, KW_COMMUNICATE, KW_BINARY), handleBinaryMode},
+    {scpi_key(SET, KW_SYS, KW_COMMUNICATE, KW_BAUD), handleSetBaud},
+    {scpi_key(QUERY, KW_SYS, KW_COMMUNICATE, KW_BAUD), handleGetBaud},
+    {scpi_key(SET, KW_SYS, KW_COMMUNICATE, KW_BAUD, KW_CONFIRM),
+     handleConfirmBaud},
+    {scpi_key(SET, KW_SYS, KW_COMMUNICATE, KW_BAUD, KW_SAVE), handleSaveBaud},
+#if CMD_STATS
+    {scpi_key(QUERY, KW_SYS, KW_STATISTICS), handleGetStats},
+#endif
+
+    // Pattern Commands
+    {scpi_key(SET, KW_PATTERN, KW_STOP), handleStop},
+    {scpi_key(SET, KW_PATTERN, KW_START), handleStart},
+    {scpi_key(SET, KW_PATTERN, KW_UPDATE), handleUpdate},
+
+    // Channel Commands
+    {scpi_key(SET, KW_CHANNEL, KW_VOLTAGE), handleSetVoltage},
+    {scpi_key(QUERY, KW_CHANNEL, KW_VOLTAGE), handleGetVoltage},
+    {scpi_key(SET, KW_CHANNEL, KW_PHASE), handleSetPhase},
+    {scpi_key(QUERY, KW_CHANNEL, KW_PHASE), handleGetPhase},
+    {scpi_key(SET, KW_CHANNEL, KW_SOURCE), handleSetSource},
+    {scpi_key(QUERY, KW_CHANNEL, KW_SOURCE), handleGetSource},
+
+    // Multi-channel Commands
+    {scpi_key(SET, KW_CHANNEL, KW_ALL, KW_VOLTAGE), handleSetAllVoltage},
+    {scpi_key(SET, KW_CHANNEL, KW_ALL, KW_PHASE), handleSetAllPhase},
+    {scpi_key(SET, KW_CHANNEL, KW_ALL, KW_STATE), handleSetAllState},
+
+    // Sweep Commands
+    {scpi_key(SET, KW_SOURCE, KW_SWEEP, KW_FREQUENCY), handleSweepFreq},
+    {scpi_key(SET, KW_SOURCE, KW_SWEEP, KW_VOLTAGE), handleSweepVolt},
+    {scpi_key(SET, KW_SOURCE, KW_SWEEP, KW_START), handleSequenceStart},
+    {scpi_key(SET, KW_SOURCE, KW_SWEEP, KW_STOP), handleSequenceStop},
+    {scpi_key(QUERY, KW_SOURCE, KW_SWEEP, KW_STATE), handleSequenceState},
+
+    // List Commands
+    {scpi_key(SET, KW_SOURCE, KW_LIST, KW_CLEAR), handleListClear},
+    {scpi_key(SET, KW_SOURCE, KW_LIST, KW_APPEND), handleListAppend},
+    {scpi_key(SET, KW_SOURCE, KW_LIST, KW_COUNT), handleListCount},
+    {scpi_key(SET, KW_SOURCE, KW_LIST, KW_START), handleSequenceStart},
+    {scpi_key(SET, KW_SOURCE, KW_LIST, KW_STOP), handleSequenceStop},
+    {scpi_key(QUERY, KW_SOURCE, KW_LIST, KW_STATE), handleSequenceState},
+
+    // Waveform Commands
+    {scpi_key(SET, KW_SOURCE, KW_TRACE, KW_LOAD), handleTraceLoad},
+    {scpi_key(SET, KW_SOURCE, KW_TRACE, KW_SHAPE), handleTraceShape},
+
+    // Trigger Commands
+    {scpi_key(SET, KW_TRIGGER, KW_SOURCE), handleTrigSource},
+    {scpi_key(SET, KW_TRIGGER, KW_SLOPE), handleTrigSlope},
+    {scpi_key(SET, KW_TRIGGER, KW_ACTION), handleTrigAction},
+};
+
+const uint8_t SCPI_COMMANDS = sizeof(scpi_commands) / sizeof(scpi_commands[0]);
+
+// Hash multiplier, perfect for the table above. Pick another odd constant
+// if the assert below fails after adding a command.
+constexpr uint32_t SCPI_HASH_MUL = 0x81843eef;
+
+static_assert(scpi_perfect(scpi_commands, SCPI_COMMANDS, SCPI_HASH_MUL),
+              "SCPI_HASH_MUL maps two commands to one slot");
+
+constexpr uint8_t scpi_slots[SCPI_HASH_SLOTS] PROGMEM =
+    SCPI_SLOTS(scpi_commands, SCPI_COMMANDS, SCPI_HASH_MUL);
+
+#endif
@@ -0,0 +1,301 @@
+/******************************************************************************
+    @file:  scpi_dispatch.h
+
+    @brief: SCPI command lookup through tables built at compile time
+******************************************************************************/
+
+#ifndef SCPI_DISPATCH_H
+#define SCPI_DISPATCH_H
+
+#include <Vrekrer_scpi_parser.h>
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "command_stats.h"
+#include "global_error.h"
+#include "ram_guard.h"
+
+extern GlobalError system_error;
+
+// Host builds count handler calls, see host/Makefile
+#ifndef SCPI_HANDLER_HOOK
+#define SCPI_HANDLER_HOOK()
+#endif
+
+/**
+ * @brief SCPI command handler
+ *
+ * @param suffix Number after a "#" keyword (CHANnel3 -> 3), 0 if there was
+ * none
+ */
+typedef void (*ScpiHandler)(uint8_t suffix, SCPI_P& params, Stream& interface);
+
+/*
+ * Each header token is matched against a table of keywords ("CHANnel#",
+ * "VOLTage"), which accepts the short (upper case) or the long form in any
+ * case, plus digits after a keyword ending in "#". The ids of up to four
+ * keywords and the query flag form a key:
+ *
+ *   key = k0 << 19 | k1 << 13 | k2 << 7 | k3 << 1 | query
+ *
+ * Keys are placed in a slot table at compile time with a multiplicative hash
+ * that the command set is checked to be perfect for, so a header resolves
+ * to its handler with one multiply and one key compare.
+ */
+const uint8_t SCPI_KEY_BITS = 6;  // keyword ids 1 - 63, 0 for no keyword
+const uint8_t SCPI_KEY_DEPTH = 4;
+const uint8_t SCPI_HASH_BITS = 7;
+const uint8_t SCPI_HASH_SLOTS = 1 << SCPI_HASH_BITS;
+
+constexpr bool QUERY = true;
+constexpr bool SET = false;
+
+struct ScpiCommand {
+  uint32_t key;
+  ScpiHandler handler;
+};
+
+constexpr uint32_t scpi_key(bool query, uint8_t k0, uint8_t k1 = 0,
+                            uint8_t k2 = 0, uint8_t k3 = 0) {
+  return ((((((uint32_t)k0 << SCPI_KEY_BITS | k1) << SCPI_KEY_BITS | k2)
+            << SCPI_KEY_BITS) |
+           k3)
+          << 1) |
+         query;
+}
+
+constexpr uint8_t scpi_hash(uint32_t key, uint32_t mul) {
+  return (uint32_t)(key * mul) >> (32 - SCPI_HASH_BITS);
+}
+
+// 1 + index of the command hashed to `slot`, 0 if there is none
+constexpr uint8_t scpi_find_slot(const ScpiCommand* commands, uint8_t count,
+                                 uint32_t mul, uint8_t slot, uint8_t i = 0) {
+  return (i >= count) ? 0
+         : (scpi_hash(commands[i].key, mul) == slot)
+             ? i + 1
+             : scpi_find_slot(commands, count, mul, slot, i + 1);
+}
+
+// True if no command from j on hashes to `slot`
+constexpr bool scpi_slot_free(const ScpiCommand* commands, uint8_t count,
+                              uint32_t mul, uint8_t slot, uint8_t j) {
+  return (j >= count) ? true
+         : (scpi_hash(commands[j].key, mul) == slot)
+             ? false
+             : scpi_slot_free(commands, count, mul, slot, j + 1);
+}
+
+// True if no command from i on hashes to the same slot as a later one
+constexpr bool scpi_perfect(const ScpiCommand* commands, uint8_t count,
+                            uint32_t mul, uint8_t i = 0) {
+  return (i >= count) ||
+         (scpi_slot_free(commands, count, mul,
+                         scpi_hash(commands[i].key, mul), i + 1) &&
+          scpi_perfect(commands, count, mul, i + 1));
+}
+
+#define SCPI_SLOTS_4(c, n, m, s)                                     \
+  scpi_find_slot(c, n, m, s), scpi_find_slot(c, n, m, s + 1),        \
+      scpi_find_slot(c, n, m, s + 2), scpi_find_slot(c, n, m, s + 3)
+#define SCPI_SLOTS_32(c, n, m, s)                                    \
+  SCPI_SLOTS_4(c, n, m, s), SCPI_SLOTS_4(c, n, m, s + 4),            \
+      SCPI_SLOTS_4(c, n, m, s + 8), SCPI_SLOTS_4(c, n, m, s + 12),   \
+      SCPI_SLOTS_4(c, n, m, s + 16), SCPI_SLOTS_4(c, n, m, s + 20),  \
+      SCPI_SLOTS_4(c, n, m, s + 24), SCPI_SLOTS_4(c, n, m, s + 28)
+// Initializer of the SCPI_HASH_SLOTS entry slot table for a command table
+#define SCPI_SLOTS(c, n, m)                                          \
+  {                                                                  \
+    SCPI_SLOTS_32(c, n, m, 0), SCPI_SLOTS_32(c, n, m, 32),           \
+        SCPI_SLOTS_32(c, n, m, 64), SCPI_SLOTS_32(c, n, m, 96)       \
+  }
+
+/**
+ * @brief Compare a header token with a keyword from flash
+ *
+ * @param keyword Keyword, "#" at the end if it takes a number
+ * @param token Token without "?"
+ * @param len Token length
+ * @param suffix Set to the number after the keyword, if any
+ */
+bool scpi_keyword_matches(const char* keyword, const char* token, uint8_t len,
+                          uint8_t& suffix) {
+  uint8_t short_len = 0;
+  uint8_t long_len = 0;
+  bool numbered = false;
+  for (char c = pgm_read_byte(keyword); c != '\0';
+       c = pgm_read_byte(keyword + ++long_len)) {
+    if (c == '#') {
+      numbered = true;
+      break;
+    }
+    if (short_len == long_len && !islower(c))
+      short_len++;
+  }
+
+  uint8_t digits = 0;
+  if (numbered) {
+    while (digits < len && isdigit(token[len - 1 - digits]))
+      digits++;
+  }
+  uint8_t word = len - digits;
+  if (word != short_len && word != long_len)
+    return false;
+  for (uint8_t i = 0; i < word; i++) {
+    if (toupper(token[i]) != toupper(pgm_read_byte(keyword + i)))
+      return false;
+  }
+
+  uint16_t number = 0;
+  for (uint8_t i = word; i < len; i++) {
+    number = number * 10 + (token[i] - '0');
+    if (number > 0xff)
+      number = 0xff;
+  }
+  if (digits)
+    suffix = number;
+  return true;
+}
+
+class ScpiDispatcher {
+ public:
+  /**
+   * @param keywords Keyword strings in flash, id i + 1 at index i
+   * @param keyword_count Number of keywords
+   * @param commands Command table in flash
+   * @param slots Slot table in flash, see SCPI_SLOTS()
+   * @param mul Hash multiplier the slot table was built with
+   */
+  ScpiDispatcher(const char* const* keywords, uint8_t keyword_count,
+                 const ScpiCommand* commands, const uint8_t* slots,
+                 uint32_t mul)
+      : keywords(keywords),
+        keyword_count(keyword_count),
+        commands(commands),
+        slots(slots),
+        mul(mul) {}
+
+  /**
+   * @brief Looks up and runs the command on a line
+   *
+   * Sets an Unknown Cmd error if the header is not in the table. The line is
+   * split in place.
+   */
+  void execute(char* message, Stream& interface) {
+    uint32_t key = 0;
+    uint8_t depth = 0;
+    uint8_t suffix = 0;
+    bool query = false;
+
+    char* p = message + strspn(message, " \t");
+    while (*p != '\0' && *p != ' ' && *p != '\t') {
+      if (*p == ':') {
+        p++;
+        continue;
+      }
+      uint8_t len = strcspn(p, ": \t");
+      char* next = p + len;
+      if (len > 0 && p[len - 1] == '?') {
+        query = true;
+        len--;
+      }
+      uint8_t id = match(p, len, suffix);
+      if (id == 0 || depth == SCPI_KEY_DEPTH || (query && *next == ':')) {
+        unknown();
+        return;
+      }
+      key = (key << SCPI_KEY_BITS) | id;
+      depth++;
+      p = next;
+    }
+    if (depth == 0) {
+      unknown();
+      return;
+    }
+    key = (key << (SCPI_KEY_BITS * (SCPI_KEY_DEPTH - depth) + 1)) | query;
+
+    uint8_t index = pgm_read_byte(slots + scpi_hash(key, mul));
+    if (index == 0 || pgm_read_dword(&commands[index - 1].key) != key) {
+      unknown();
+      return;
+    }
+    index--;
+
+    SCPI_P params;
+    if (*p != '\0') {
+      *p++ = '\0';
+      for (char* tok = strtok(p, ", \t"); tok; tok = strtok(NULL, ", \t")) {
+        // SCPI_P drops what does not fit, which would run the command with
+        // the list cut short
+        if (params.Size() == SCPI_ARRAY_SYZE) {
+          system_error.set_error(GenericError::TooManyParams);
+          return;
+        }
+        params.Append(tok);
+      }
+    }
+    ScpiHandler handler = (ScpiHandler)pgm_read_ptr(&commands[index].handler);
+    SCPI_HANDLER_HOOK();
+    ram_guard.check();
+    STAT_TIME(stat_first + index, handler(suffix, params, interface));
+  }
+
+  /**
+   * @brief Prints the header of command `index` with long keywords
+   */
+  void printHeader(uint8_t index, Stream& interface) {
+    uint32_t key = pgm_read_dword(&commands[index].key);
+    for (int8_t level = SCPI_KEY_DEPTH - 1; level >= 0; level--) {
+      uint8_t id = (key >> (SCPI_KEY_BITS * level + 1)) &
+                   ((1 << SCPI_KEY_BITS) - 1);
+      if (id == 0)
+        break;
+      if (level != SCPI_KEY_DEPTH - 1)
+        interface.print(':');
+      const char* keyword = (const char*)pgm_read_ptr(&keywords[id - 1]);
+      for (char c = pgm_read_byte(keyword); c != '\0' && c != '#';
+           c = pgm_read_byte(++keyword))
+        interface.print(c);
+    }
+    if (key & 1)
+      interface.print('?');
+  }
+
+#if CMD_STATS
+  /**
+   * @brief Reserves a statistics slot for every command
+   */
+  void addStats(uint8_t count,
+                void (*namer)(uint8_t index, Stream& interface)) {
+    stat_first = cmd_stats.add(count, namer);
+  }
+#endif
+
+ private:
+  const char* const* keywords;
+  uint8_t keyword_count;
+  const ScpiCommand* commands;
+  const uint8_t* slots;
+  uint32_t mul;
+#if CMD_STATS
+  uint8_t stat_first = STAT_NONE;
+#endif
+
+  /**
+   * @return Id of the keyword a token names, 0 if there is none
+   */
+  uint8_t match(const char* token, uint8_t len, uint8_t& suffix) {
+    for (uint8_t i = 0; i < keyword_count; i++) {
+      const char* keyword = (const char*)pgm_read_ptr(&keywords[i]);
+      if (toupper(token[0]) == pgm_read_byte(keyword) &&
+          scpi_keyword_matches(keyword, token, len, suffix))
+        return i + 1;
+    }
+    return 0;
+  }
+
+  void unknown() {
+    system_error.set_error(SCPI_Parser::ErrorCode::UnknownCommand);
+  }
+};
+
+#endif
@@ -0,0 +1,208 @@
+/******************************************************************************
+    @file:  sequencer.h
+
+    @brief: Timed playback of precomputed output states (sweeps and lists)
+******************************************************************************/
+
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include "Arduino.h"
+#include "global_error.h"
+#include "model.h"
+
+extern GlobalError system_error;
+
+// 24 bytes each. A CMD_STATS build gives 8 of them to the statistics.
+const uint8_t SEQ_MAX_ENTRIES = CMD_STATS ? 16 : 24;
+const unsigned long SEQ_MIN_DWELL_US = 500;
+
+struct SequenceEntry {
+  OutputWords words;
+  unsigned long dwell_us;  // time until the next entry
+};
+
+/*
+ * Entries hold register words converted by Model::prepare() when they are
+ * loaded. While playing, poll() only compares micros() against the next due
+ * time and streams the due entry's words, so transitions do not depend on
+ * float math or the serial link. Due times advance by exactly the dwell of
+ * each entry, so a late loop() does not shift the entries after it.
+ *
+ * Triggered playback writes the next entry to the card ahead of time and
+ * the trigger interrupt only issues the RAMUPDATE that applies it. A
+ * trigger that comes while the entry is still being written cannot apply
+ * it; poll() reports those with a TriggerMissed error.
+ */
+class Sequencer {
+ public:
+  Sequencer(Model* model) : model(model) { clear(); }
+
+  /**
+   * @brief Stops playback and empties the table
+   */
+  void clear() {
+    running = false;
+    entries = 0;
+    gain_mask = 0x0f;
+    sweep = false;
+    loops = 1;
+  }
+
+  /**
+   * @brief Appends an entry, the words are filled in by the caller
+   *
+   * @return The new entry, or NULL with an error set if the table is full or
+   * the dwell is too short
+   */
+  SequenceEntry* append(unsigned long dwell_us) {
+    if (entries >= SEQ_MAX_ENTRIES || dwell_us < SEQ_MIN_DWELL_US) {
+      system_error.set_error(GenericError::ParamOutOfRange);
+      return NULL;
+    }
+    running = false;
+    table[entries].dwell_us = dwell_us;
+    return &table[entries++];
+  }
+
+  /**
+   * @brief Marks the table as a sweep whose entries set the DGAIN word of
+   * the channels in `mask` only
+   */
+  void setGainMask(uint8_t mask) {
+    gain_mask = mask;
+    sweep = true;
+  }
+
+  /**
+   * @brief Checks if the table holds a sweep rather than a list
+   */
+  bool holdsSweep() { return sweep; }
+
+  /**
+   * @brief Sets how many times the table is played, 0 for endless
+   */
+  void setLoops(uint16_t count) { loops = count; }
+
+  /**
+   * @brief Applies the first entry and starts playback
+   *
+   * When triggered, the first entry is only staged and waits for a trigger.
+   */
+  void start() {
+    if (entries == 0) {
+      system_error.set_error(GenericError::NoSequence);
+      return;
+    }
+    index = 0;
+    passes = 0;
+    running = true;
+    if (triggered) {
+      model->stage(table[0].words, gain_mask);
+      staged = true;
+      return;
+    }
+    due = micros();
+    poll();
+  }
+
+  void stop() {
+    running = false;
+    staged = false;
+  }
+
+  /**
+   * @brief Steps on trigger edges instead of dwell times
+   */
+  void setTriggered(bool on) {
+    if (on != triggered)
+      stop();
+    triggered = on;
+  }
+
+  /**
+   * @brief Applies the staged entry, from the trigger interrupt
+   */
+  void commitStaged() {
+    if (!running)
+      return;
+    if (staged) {
+      model->commit();
+      staged = false;
+    } else if (missed < 0xff) {
+      missed++;
+    }
+  }
+
+  /**
+   * @brief Applies the next entry once its due time has passed, or stages
+   * the next entry once the trigger has applied the previous one
+   *
+   * Called every loop. The last entry stays applied when playback ends.
+   */
+  void poll() {
+    if (missed) {
+      noInterrupts();
+      missed = 0;
+      interrupts();
+      system_error.set_error(GenericError::TriggerMissed);
+    }
+    if (!running)
+      return;
+    if (triggered) {
+      if (staged)
+        return;
+      advance();
+      if (running) {
+        model->stage(table[index].words, gain_mask);
+        staged = true;
+      }
+      return;
+    }
+    if ((long)(micros() - due) < 0)
+      return;
+    model->apply(table[index].words, gain_mask);
+    due += table[index].dwell_us;
+    advance();
+  }
+
+  bool isRunning() { return running; }
+
+  /**
+   * @brief Index of the next entry to apply
+   */
+  uint8_t position() { return index; }
+
+  uint8_t size() { return entries; }
+
+  /**
+   * @brief Completed passes through the table since start()
+   */
+  uint16_t passesDone() { return passes; }
+
+ private:
+  Model* model;
+  SequenceEntry table[SEQ_MAX_ENTRIES];
+  uint8_t entries;
+  uint8_t index = 0;  // next entry to apply
+  uint8_t gain_mask;
+  bool sweep;  // loaded by configure_sweep(), see setGainMask()
+  uint16_t loops = 1;
+  uint16_t passes = 0;
+  unsigned long due = 0;  // micros() at which table[index] is applied
+  bool running;
+  bool triggered = false;
+  volatile bool staged = false;  // table[index] is on the card, not applied
+  volatile uint8_t missed = 0;   // triggers before table[index] was staged
+
+  void advance() {
+    if (++index < entries)
+      return;
+    index = 0;
+    passes++;
+    if (loops != 0 && passes >= loops)
+      running = false;
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+/******************************************************************************
+    @file:  serial_link.h
+
+    @brief: Serial baud rate negotiation with fallback and stored default
+******************************************************************************/
+
+#ifndef SERIAL_LINK_H
+#define SERIAL_LINK_H
+
+#include <EEPROM.h>
+#include "Arduino.h"
+#include "config.h"
+#include "global_error.h"
+
+extern GlobalError system_error;
+
+const unsigned long LINK_DEFAULT_BAUD = 9600;
+const unsigned long LINK_CONFIRM_TIMEOUT = 2000;  // ms to confirm a new rate
+const uint8_t LINK_MAGIC = 0xb5;  // marks a stored power-on rate as valid
+
+// Rates the Uno's UART reaches within 2.1% error at 16 MHz
+const unsigned long link_rates[] PROGMEM = {9600,   19200,  38400,
+                                            57600,  115200, 250000,
+                                            500000, 1000000};
+
+struct LinkSettings {
+  uint8_t magic;
+  unsigned long baud;
+};
+
+/*
+ * Switching rate: the command is acknowledged at the old rate, then the UART
+ * moves to the new one. The host must send SYS:COMM:BAUD:CONF at the new rate
+ * within LINK_CONFIRM_TIMEOUT, otherwise poll() moves back to the old rate.
+ */
+class SerialLink {
+ public:
+  /**
+   * @brief Opens Serial at the stored power-on rate
+   */
+  void begin() {
+    LinkSettings settings;
+    EEPROM.get(EEPROM_LINK_ADDR, settings);
+    baud = (settings.magic == LINK_MAGIC && isSupported(settings.baud))
+               ? settings.baud
+               : LINK_DEFAULT_BAUD;
+    Serial.begin(baud);
+    pending = false;
+  }
+
+  /**
+   * @brief Checks a rate against link_rates
+   */
+  bool isSupported(unsigned long rate) {
+    for (uint8_t i = 0; i < sizeof(link_rates) / sizeof(link_rates[0]); i++) {
+      if (pgm_read_dword_near(&link_rates[i]) == rate)
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Moves the UART to a new rate pending confirmation
+   *
+   * Output queued at the old rate is drained first.
+   */
+  void change(unsigned long rate) {
+    if (!pending)
+      old_baud = baud;
+    reopen(rate);
+    pending = true;
+    started = millis();
+  }
+
+  /**
+   * @brief Keeps the current rate
+   */
+  void confirm() { pending = false; }
+
+  /**
+   * @brief Reverts an unconfirmed rate change after the timeout
+   */
+  void poll() {
+    if (pending && millis() - started > LINK_CONFIRM_TIMEOUT) {
+      reopen(old_baud);
+      pending = false;
+      system_error.set_error(GenericError::LinkTimeout);
+    }
+  }
+
+  /**
+   * @brief Stores the current rate as the power-on default
+   */
+  void save() {
+    LinkSettings settings = {LINK_MAGIC, baud};
+    EEPROM.put(EEPROM_LINK_ADDR, settings);
+  }
+
+  unsigned long rate() { return baud; }
+  bool isPending() { return pending; }
+
+ private:
+  unsigned long baud = LINK_DEFAULT_BAUD;
+  unsigned long old_baud = LINK_DEFAULT_BAUD;
+  unsigned long started = 0;
+  bool pending = false;
+
+  void reopen(unsigned long rate) {
+    Serial.flush();
+    Serial.end();
+    Serial.begin(rate);
+    baud = rate;
+  }
+};
+
+#endif
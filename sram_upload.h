@@ -0,0 +1,163 @@
+/******************************************************************************
+    @file:  sram_upload.h
+
+    @brief: Chunked binary upload of a waveform into the AD9106 pattern SRAM
+******************************************************************************/
+
+#ifndef SRAM_UPLOAD_H
+#define SRAM_UPLOAD_H
+
+#include <Vrekrer_scpi_parser.h>
+#include "Arduino.h"
+#include "binary_protocol.h"
+#include "global_error.h"
+
+extern GlobalError system_error;
+
+/*
+ * SOURce:TRACe:LOAD <start>,<words> answers "READY <chunk words>", then the
+ * interface takes the waveform as chunks:
+ *
+ *   Chunk:  SYNC(0xA5) | seq | words (uint16 LE) | CRC-8
+ *   Reply:  ACK(0x06) | seq    chunks up to seq are written
+ *           NAK(0x15) | seq    send again from chunk seq
+ *
+ * Every chunk holds UPLOAD_CHUNK_WORDS words, the last one what is left.
+ * seq counts chunks from 0, modulo 256, and the CRC covers seq and the
+ * words as in binary_protocol.h. Words go to the SRAM as they are, DAC code
+ * in bits [15:4].
+ *
+ * A chunk is written with one SPI burst as soon as it is complete, so only
+ * one chunk is ever held in RAM. The host may send the next chunk before
+ * the reply to the previous one arrives, which keeps the link busy while a
+ * chunk is written and acknowledged. The line queue is paused meanwhile, so
+ * both chunks must wait in the 64 byte hardware buffer: at 12 words they
+ * take 54 bytes. A bad or out of order chunk is NAKed once and the chunks
+ * after it are dropped until the one asked for comes.
+ * If a reply goes missing the host sends again from the oldest chunk not
+ * acknowledged. After UPLOAD_TIMEOUT without a good chunk the upload is
+ * abandoned with a Timeout error and the interface goes back to SCPI.
+ */
+const uint8_t UPLOAD_CHUNK_WORDS = 12;
+const uint8_t UPLOAD_ACK = 0x06;
+const uint8_t UPLOAD_NAK = 0x15;
+const unsigned long UPLOAD_TIMEOUT = 2000;  // ms between good chunks
+
+static_assert(2 * (2 * UPLOAD_CHUNK_WORDS + 3) <= 64,
+              "two chunks in flight must fit the serial receive buffer");
+
+class SramUpload {
+ public:
+  bool active = false;
+
+  /**
+   * @brief Constructor for the SramUpload class
+   *
+   * @param write Called with each good chunk: first SRAM word, the words
+   * (uint16 LE) and their number
+   * @param done Called when the upload is over, complete or not
+   */
+  SramUpload(void (*write)(uint16_t, const uint8_t*, uint8_t),
+             void (*done)()) {
+    this->write = write;
+    this->done = done;
+  }
+
+  /**
+   * @brief Starts taking chunks for `words` SRAM words from `start` on
+   */
+  void begin(uint16_t start, uint16_t words) {
+    this->start = start;
+    total = words;
+    written = 0;
+    seq = 0;
+    length = 0;
+    synced = false;
+    nak_sent = false;
+    last_chunk = millis();
+    active = true;
+  }
+
+  /**
+   * @brief Consumes available bytes, writing each complete chunk
+   *
+   * Bytes before a SYNC are skipped and a chunk left incomplete for
+   * BIN_FRAME_TIMEOUT is dropped, as in BinaryProtocol::process().
+   */
+  void process(Stream& interface) {
+    if (active && millis() - last_chunk > UPLOAD_TIMEOUT) {
+      system_error.set_error(SCPI_Parser::ErrorCode::Timeout);
+      finish();
+      return;
+    }
+    while (active && interface.available()) {
+      uint8_t b = interface.read();
+      unsigned long now = millis();
+      if (synced && now - last_byte > BIN_FRAME_TIMEOUT) {
+        synced = false;
+        length = 0;
+      }
+      last_byte = now;
+
+      if (!synced) {
+        synced = (b == BIN_SYNC);
+        continue;
+      }
+      buffer[length++] = b;
+      if (length == 2 * chunkWords() + 2) {
+        synced = false;
+        length = 0;
+        handleChunk(interface);
+      }
+    }
+  }
+
+ private:
+  void (*write)(uint16_t, const uint8_t*, uint8_t);
+  void (*done)();
+  uint8_t buffer[2 * UPLOAD_CHUNK_WORDS + 2];  // seq, words, CRC
+  uint8_t length = 0;
+  bool synced = false;    // SYNC seen, filling buffer
+  bool nak_sent = false;  // chunk seq was asked for again
+  uint8_t seq = 0;        // next chunk expected
+  uint16_t start = 0;
+  uint16_t total = 0;
+  uint16_t written = 0;
+  unsigned long last_byte = 0;
+  unsigned long last_chunk = 0;
+
+  uint8_t chunkWords() {
+    uint16_t left = total - written;
+    return (left < UPLOAD_CHUNK_WORDS) ? left : UPLOAD_CHUNK_WORDS;
+  }
+
+  void handleChunk(Stream& interface) {
+    uint8_t words = chunkWords();
+    if (buffer[0] != seq ||
+        crc8(buffer, 2 * words + 1) != buffer[2 * words + 1]) {
+      if (!nak_sent)
+        reply(interface, UPLOAD_NAK, seq);
+      nak_sent = true;
+      return;
+    }
+    write(start + written, buffer + 1, words);
+    written += words;
+    nak_sent = false;
+    last_chunk = millis();
+    reply(interface, UPLOAD_ACK, seq++);
+    if (written == total)
+      finish();
+  }
+
+  void reply(Stream& interface, uint8_t code, uint8_t chunk) {
+    uint8_t out[2] = {code, chunk};
+    interface.write(out, 2);
+  }
+
+  void finish() {
+    active = false;
+    done();
+  }
+};
+
+#endif
@@ -0,0 +1,68 @@
+/******************************************************************************
+    @file:  sweep.h
+
+    @brief: Frequency and amplitude sweeps loaded into the Sequencer
+******************************************************************************/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "Arduino.h"
+#include "global_error.h"
+#include "model.h"
+#include "sequencer.h"
+
+extern GlobalError system_error;
+
+enum class SweepTarget : uint8_t { FREQUENCY, VOLTAGE };
+
+/**
+ * @brief Replaces the sequence with the points of a single-pass sweep
+ *
+ * A frequency sweep holds each channel at its requested voltage,
+ * recalibrated at every point. A voltage sweep sets all four channels to
+ * the same voltage at the current frequency. Phases stay as they are.
+ *
+ * @param target Swept quantity
+ * @param start First value (Hz or mV)
+ * @param stop Last value (Hz or mV)
+ * @param count Number of points (2 - SEQ_MAX_ENTRIES)
+ * @param log_spacing Space points geometrically instead of linearly
+ * @param dwell Time at each point in us
+ *
+ * @return true if the sweep was loaded, false with an error set otherwise
+ */
+bool load_sweep(Sequencer& seq, Model& model, SweepTarget target, float start,
+                float stop, uint8_t count, bool log_spacing,
+                unsigned long dwell) {
+  bool in_range =
+      (target == SweepTarget::FREQUENCY)
+          ? (start >= 0 && start <= 100000 && stop >= 0 && stop <= 100000)
+          : (model.voltageInRange(start) && model.voltageInRange(stop));
+  if (!in_range || count < 2 || count > SEQ_MAX_ENTRIES ||
+      dwell < SEQ_MIN_DWELL_US || (log_spacing && (start <= 0 || stop <= 0))) {
+    system_error.set_error(GenericError::ParamOutOfRange);
+    return false;
+  }
+
+  float freq = model.getFreq();
+  OutputWords words;
+  uint8_t mask = 0x0f;
+  seq.clear();
+  for (uint8_t i = 0; i < count; i++) {
+    float t = (float)i / (count - 1);
+    float value = log_spacing ? start * pow(stop / start, t)
+                              : start + (stop - start) * t;
+    if (target == SweepTarget::FREQUENCY) {
+      mask = model.prepare(words, value, NULL);
+    } else {
+      float volts[4] = {value, value, value, value};
+      mask = model.prepare(words, freq, volts);
+    }
+    seq.append(dwell)->words = words;
+  }
+  seq.setGainMask(mask);
+  return true;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/******************************************************************************
+    @file:  trigger.h
+
+    @brief: External and bus triggers for starting, stopping and stepping
+            the outputs
+******************************************************************************/
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <SPI.h>
+#include "Arduino.h"
+#include "model.h"
+#include "sequencer.h"
+
+// Only digital pins 2 and 3 have external interrupts on the Uno, and pin 3
+// latches the LCD
+const uint8_t TRIG_PIN = 2;
+
+enum class TriggerSource : uint8_t { BUS, EXTERNAL };
+enum class TriggerAction : uint8_t { NONE, START, STOP, UPDATE, STEP };
+
+/*
+ * Everything the action needs is on the card before the edge arrives: with
+ * UPDATE, Model::update() stops after writing the registers, and with STEP
+ * the Sequencer writes the next entry as soon as the previous one applied.
+ * The ISR then issues a single SPI write (RAMUPDATE or PAT_STATUS).
+ * Model runs every card access in an SPI transaction, and
+ * SPI.usingInterrupt() masks the trigger during them, so the ISR waits for
+ * a frame in progress instead of splitting it. START and UPDATE are
+ * dropped while the pattern SRAM is open for an upload, and a STOP then
+ * only keeps the pattern stopped afterwards, see Model::stop_pattern().
+ */
+class Trigger {
+ public:
+  TriggerSource source = TriggerSource::BUS;
+  int mode = RISING;  // RISING, FALLING or CHANGE
+  TriggerAction action = TriggerAction::NONE;
+  volatile uint16_t count = 0;  // triggers received since configure()
+
+  Trigger(Model* model, Sequencer* seq) : model(model), seq(seq) {}
+
+  /**
+   * @brief Sets up the trigger pin
+   */
+  void begin() {
+    pinMode(TRIG_PIN, INPUT_PULLUP);
+    SPI.usingInterrupt(digitalPinToInterrupt(TRIG_PIN));
+  }
+
+  /**
+   * @brief Applies a new source, edge and action
+   */
+  void configure(TriggerSource new_source, int new_mode,
+                 TriggerAction new_action);
+
+  /**
+   * @brief Performs the action, from the ISR or a bus trigger
+   */
+  void fire() {
+    count++;
+    switch (action) {
+      case TriggerAction::START:
+        if (!model->sramOpen())
+          model->start_pattern();
+        break;
+      case TriggerAction::STOP:
+        model->stop_pattern();
+        break;
+      case TriggerAction::UPDATE:
+        if (!model->sramOpen())
+          model->commit();
+        break;
+      case TriggerAction::STEP:
+        seq->commitStaged();
+        break;
+      default:
+        break;
+    }
+  }
+
+ private:
+  Model* model;
+  Sequencer* seq;
+};
+
+extern Trigger trigger;
+
+void trigger_isr() { trigger.fire(); }
+
+void Trigger::configure(TriggerSource new_source, int new_mode,
+                        TriggerAction new_action) {
+  detachInterrupt(digitalPinToInterrupt(TRIG_PIN));
+  if (action == TriggerAction::UPDATE && new_action != TriggerAction::UPDATE) {
+    // Apply anything update() left for the trigger
+    model->deferUpdates(false);
+    model->update();
+  }
+
+  source = new_source;
+  mode = new_mode;
+  action = new_action;
+  count = 0;
+  model->deferUpdates(action == TriggerAction::UPDATE);
+  seq->setTriggered(action == TriggerAction::STEP);
+
+  if (source == TriggerSource::EXTERNAL && action != TriggerAction::NONE)
+    attachInterrupt(digitalPinToInterrupt(TRIG_PIN), trigger_isr, mode);
+}
+
+#endif
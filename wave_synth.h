@@ -0,0 +1,103 @@
+/******************************************************************************
+    @file:  wave_synth.h
+
+    @brief: Fixed-point waveform samples for the AD9106 pattern SRAM
+******************************************************************************/
+
+#ifndef WAVE_SYNTH_H
+#define WAVE_SYNTH_H
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+
+const uint8_t SYNTH_HARMONICS = 7;     // most terms in a HARMonics sum
+const uint8_t SYNTH_BURST_WORDS = 64;  // SRAM words per SPI transaction
+
+enum class SynthShape : uint8_t { SINE, TRIANGLE, RAMP, SQUARE, HARMONICS };
+
+/**
+ * @brief One period of a waveform, as parsed from SOURce:TRACe:SHAPe
+ */
+struct SynthWave {
+  SynthShape shape;
+  uint8_t harmonics;              // terms in amps[]
+  uint16_t duty;                  // SQUARE: phase where the output goes low
+  int16_t amps[SYNTH_HARMONICS];  // HARMONICS: Q15 amplitude of each term
+};
+
+/*
+ * Samples are Q15 (full scale +-32767) of a 16 bit phase, 0x10000 being one
+ * period, and use no floats. The sine comes from sin(i * pi / 256) over the
+ * first quarter period, interpolated between entries and mirrored for the
+ * other quarters, so it costs two table reads and a 16 bit multiply.
+ */
+const int16_t synth_sine_quarter[129] PROGMEM = {
+    0,     402,   804,   1206,  1608,  2009,  2410,  2811,  3212,  3612,
+    4011,  4410,  4808,  5205,  5602,  5998,  6393,  6786,  7179,  7571,
+    7962,  8351,  8739,  9126,  9512,  9896,  10278, 10659, 11039, 11417,
+    11793, 12167, 12539, 12910, 13279, 13645, 14010, 14372, 14732, 15090,
+    15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869, 18204, 18537,
+    18868, 19195, 19519, 19841, 20159, 20475, 20787, 21096, 21403, 21705,
+    22005, 22301, 22594, 22884, 23170, 23452, 23731, 24007, 24279, 24547,
+    24811, 25072, 25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019,
+    27245, 27466, 27683, 27896, 28105, 28310, 28510, 28706, 28898, 29085,
+    29268, 29447, 29621, 29791, 29956, 30117, 30273, 30424, 30571, 30714,
+    30852, 30985, 31113, 31237, 31356, 31470, 31580, 31685, 31785, 31880,
+    31971, 32057, 32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+    32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765, 32767};
+
+/**
+ * @brief Q15 sine of a 16 bit phase
+ */
+int16_t synth_sine(uint16_t phase) {
+  uint16_t p = phase & 0x3fff;
+  if (phase & 0x4000)
+    p = 0x4000 - p;  // falling quarters run the table backwards
+  uint8_t index = p >> 7;
+  uint8_t frac = p & 0x7f;
+  int16_t value = pgm_read_word(&synth_sine_quarter[index]);
+  if (frac) {
+    // Steps are at most 402, so the product fits 16 bits
+    uint16_t step = pgm_read_word(&synth_sine_quarter[index + 1]) - value;
+    value += (step * frac) >> 7;
+  }
+  return (phase & 0x8000) ? -value : value;
+}
+
+/**
+ * @brief Q15 sample of a waveform at a 16 bit phase
+ */
+int16_t synth_sample(const SynthWave& wave, uint16_t phase) {
+  switch (wave.shape) {
+    case SynthShape::SINE:
+      return synth_sine(phase);
+    case SynthShape::TRIANGLE: {
+      // Up from -full scale over the first half period, down over the second
+      uint16_t twice = phase << 1;
+      return (phase & 0x8000) ? (int16_t)(0x7fff - twice)
+                              : (int16_t)(twice ^ 0x8000);
+    }
+    case SynthShape::RAMP:
+      return (int16_t)(phase ^ 0x8000);
+    case SynthShape::SQUARE:
+      return (phase < wave.duty) ? 32767 : -32767;
+    case SynthShape::HARMONICS: {
+      // Each term is shifted to Q15 first: seven full scale products would
+      // overflow 32 bits, seven Q15 terms fit easily
+      int32_t sum = 0;
+      uint16_t term = 0;
+      for (uint8_t k = 0; k < wave.harmonics; k++) {
+        term += phase;  // phase of harmonic k + 1
+        sum += ((int32_t)synth_sine(term) * wave.amps[k]) >> 15;
+      }
+      if (sum > 32767)
+        return 32767;
+      if (sum < -32767)
+        return -32767;
+      return sum;
+    }
+  }
+  return 0;
+}
+
+#endif